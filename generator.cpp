@@ -22,30 +22,164 @@
  */
 
 #include "generator.h"
+#include "generatorcache.h"
+#include "generatorshards.h"
+#include "outputwriter.h"
+#include "profiler.h"
+#include "generatorrunnerconfig.h"
 #include "reporthandler.h"
-#include "fileout.h"
 #include "apiextractor.h"
 
+#include <QtCore/QCryptographicHash>
 #include <QtCore/QDir>
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QQueue>
+#include <QtCore/QRunnable>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThreadPool>
+#include <QtCore/QTime>
+#include <QtCore/QVarLengthArray>
+#include <QtCore/QVector>
 #include <QDebug>
 #include <typedatabase.h>
+#ifdef __GLIBC__
+    #include <malloc.h>
+#endif
+
+typedef QHash<const AbstractMetaClass*, AbstractMetaClassList> SubclassIndex;
 
 struct Generator::GeneratorPrivate {
     const ApiExtractor* apiextractor;
+    AbstractMetaClassList classes;
+    SubclassIndex directSubclasses;
+    SubclassIndex allSubclasses;
+    QHash<const TypeEntry*, const AbstractMetaClass*> classesByTypeEntry;
+    QHash<QString, const AbstractMetaClass*> classesByName;
+    // Minimal constructors already found, by class type entry.
+    QHash<const TypeEntry*, QString> minimalConstructors;
+    QMutex minimalConstructorsMutex;
     QString outDir;
     // License comment
     QString licenseComment;
     QString packageName;
+    QMap<QString, QString> args;
     int numGenerated;
     int numGeneratedWritten;
+    int numberOfJobs;
+    bool incremental;
+    QByteArray buildId;
+    int shardIndex;
+    int shardCount;
+    bool mergeShards;
+    qint64 memoryLimit;
+    bool failed;
+};
+
+/**
+*   Generates the output of a single class into its own buffer, possibly on a
+*   worker thread. The buffer is handed to the output writer by commit(), that
+*   must be called from the thread running Generator::generate().
+*   A task created with upToDate set only reports the class as generated,
+*   its output file was left unchanged by the incremental cache.
+*/
+struct Generator::GenerationTask : public QRunnable
+{
+    GenerationTask(Generator* generator, const AbstractMetaClass* metaClass,
+                   const QString& filePath, bool upToDate, int sizeHint)
+        : generator(generator), metaClass(metaClass), filePath(filePath), upToDate(upToDate),
+          cost(-1), stream(&buffer)
+    {
+        setAutoDelete(false);
+        if (!upToDate)
+            buffer.reserve(sizeHint);
+    }
+
+    void run()
+    {
+        if (!upToDate) {
+            // The name is only built when the profiler records it.
+            ProfileScope scope(generator->name(), Profiler::isEnabled() ? metaClass->qualifiedCppName() : QString());
+            QTime timer;
+            timer.start();
+            generator->generateClass(stream, metaClass);
+            stream.flush();
+            cost = timer.elapsed();
+        }
+        finished.release();
+    }
+
+    void commit(OutputWriter* writer, GeneratorShards* shards)
+    {
+        finished.acquire();
+        if (!upToDate)
+            writer->write(filePath, fileContents(buffer));
+        ++generator->m_d->numGenerated;
+        shards->addGenerated(metaClass->qualifiedCppName(), cost);
+        generator->classGenerated(metaClass);
+        if (!endOfBatch.isEmpty())
+            generator->endBatch(endOfBatch);
+    }
+
+    /**
+    *   Same bytes FileOut writes: the stream buffer is read back as ASCII and saved as UTF-8.
+    *   Both conversions leave ASCII untouched, so most buffers are used as they are.
+    */
+    static QByteArray fileContents(const QByteArray& buffer)
+    {
+        const char* data = buffer.constData();
+        for (int i = 0; i < buffer.size(); ++i) {
+            if (static_cast<uchar>(data[i]) >= 0x80)
+                return QString::fromAscii(data, buffer.size()).toUtf8();
+        }
+        return buffer;
+    }
+
+    Generator* generator;
+    const AbstractMetaClass* metaClass;
+    QString filePath;
+    bool upToDate;
+    // Milliseconds taken by generateClass(), -1 if it wasn't called.
+    int cost;
+    // The batch ended by this class, if any.
+    AbstractMetaClassList endOfBatch;
+    QByteArray buffer;
+    QTextStream stream;
+    QSemaphore finished;
+};
+
+/// A class generate() will go through, in the order of classes().
+struct PlannedClass
+{
+    AbstractMetaClass* metaClass;
+    // Classes with the same outermost class make up a batch.
+    const AbstractMetaClass* outermost;
+    QString fileName;
+    QString filePath;
+    QByteArray fingerprint;
+    bool upToDate;
 };
 
+static const AbstractMetaClass* outermostClass(const AbstractMetaClass* metaClass)
+{
+    while (metaClass->enclosingClass())
+        metaClass = metaClass->enclosingClass();
+    return metaClass;
+}
+
 Generator::Generator() : m_d(new GeneratorPrivate)
 {
     m_d->numGenerated = 0;
     m_d->numGeneratedWritten = 0;
+    m_d->numberOfJobs = 1;
+    m_d->incremental = false;
+    m_d->shardIndex = 1;
+    m_d->shardCount = 1;
+    m_d->mergeShards = false;
+    m_d->memoryLimit = 0;
+    m_d->failed = false;
 }
 
 Generator::~Generator()
@@ -53,25 +187,53 @@ Generator::~Generator()
     delete m_d;
 }
 
-bool Generator::setup(const ApiExtractor& extractor, const QMap< QString, QString > args)
+GeneratorRunContext::GeneratorRunContext()
 {
-    m_d->apiextractor = &extractor;
+    // The package is the first type system entry being generated.
     TypeEntryHash allEntries = TypeDatabase::instance()->allEntries();
-    TypeEntry* entryFound = 0;
-    foreach (QList<TypeEntry*> entryList, allEntries.values()) {
-        foreach (TypeEntry* entry, entryList) {
+    for (TypeEntryHash::const_iterator it = allEntries.constBegin(); it != allEntries.constEnd(); ++it) {
+        foreach (const TypeEntry* entry, it.value()) {
             if (entry->type() == TypeEntry::TypeSystemType && entry->generateCode()) {
-                entryFound = entry;
-                break;
+                m_packageName = entry->name();
+                return;
             }
         }
-        if (entryFound)
-            break;
+    }
+}
+
+bool Generator::setup(const ApiExtractor& extractor, const QMap< QString, QString > args)
+{
+    return setup(extractor, args, GeneratorRunContext());
+}
+
+bool Generator::setup(const ApiExtractor& extractor, const QMap< QString, QString > args,
+                      const GeneratorRunContext& context)
+{
+    ProfileScope scope(name(), "setup");
+    m_d->apiextractor = &extractor;
+    m_d->classes = extractor.classes();
+    m_d->args = args;
+
+    m_d->directSubclasses.clear();
+    m_d->allSubclasses.clear();
+    m_d->classesByTypeEntry.clear();
+    m_d->classesByName.clear();
+    m_d->minimalConstructors.clear();
+    foreach (AbstractMetaClass* metaClass, m_d->classes) {
+        // The first class wins, as in a linear search of classes().
+        if (!m_d->classesByTypeEntry.contains(metaClass->typeEntry()))
+            m_d->classesByTypeEntry.insert(metaClass->typeEntry(), metaClass);
+        if (!m_d->classesByName.contains(metaClass->name()))
+            m_d->classesByName.insert(metaClass->name(), metaClass);
+
+        if (metaClass->baseClass())
+            m_d->directSubclasses[metaClass->baseClass()] << metaClass;
+        for (const AbstractMetaClass* base = metaClass->baseClass(); base; base = base->baseClass())
+            m_d->allSubclasses[base] << metaClass;
     }
 
-    if (entryFound)
-        m_d->packageName = entryFound->name();
-    else
+    m_d->packageName = context.packageName();
+    if (m_d->packageName.isEmpty())
         ReportHandler::warning("Couldn't find the package name!!");
     return doSetup(args);
 }
@@ -81,9 +243,36 @@ QMap< QString, QString > Generator::options() const
     return QMap<QString, QString>();
 }
 
-AbstractMetaClassList Generator::classes() const
+const AbstractMetaClassList& Generator::classes() const
 {
-    return m_d->apiextractor->classes();
+    return m_d->classes;
+}
+
+static const AbstractMetaClassList& findSubclasses(const SubclassIndex& index, const AbstractMetaClass* metaClass)
+{
+    static const AbstractMetaClassList noSubclasses;
+    SubclassIndex::const_iterator it = index.find(metaClass);
+    return it == index.constEnd() ? noSubclasses : it.value();
+}
+
+const AbstractMetaClassList& Generator::directSubclasses(const AbstractMetaClass* metaClass) const
+{
+    return findSubclasses(m_d->directSubclasses, metaClass);
+}
+
+const AbstractMetaClassList& Generator::allSubclasses(const AbstractMetaClass* metaClass) const
+{
+    return findSubclasses(m_d->allSubclasses, metaClass);
+}
+
+const AbstractMetaClass* Generator::findAbstractMetaClass(const TypeEntry* typeEntry) const
+{
+    return m_d->classesByTypeEntry.value(typeEntry);
+}
+
+const AbstractMetaClass* Generator::findAbstractMetaClassByName(const QString& name) const
+{
+    return m_d->classesByName.value(name);
 }
 
 AbstractMetaFunctionList Generator::globalFunctions() const
@@ -172,25 +361,485 @@ int Generator::numGeneratedAndWritten() const
     return m_d->numGeneratedWritten;
 }
 
+void Generator::setNumberOfJobs(int jobs)
+{
+    m_d->numberOfJobs = qMax(jobs, 1);
+}
+
+int Generator::numberOfJobs() const
+{
+    return m_d->numberOfJobs;
+}
+
+Generator::Capabilities Generator::capabilities() const
+{
+    return NoCapability;
+}
+
+void Generator::setIncrementalGeneration(bool enable, const QByteArray& buildId)
+{
+    m_d->incremental = enable;
+    m_d->buildId = buildId;
+}
+
+bool Generator::incrementalGeneration() const
+{
+    return m_d->incremental;
+}
+
+QByteArray Generator::buildId() const
+{
+    return m_d->buildId;
+}
+
+void Generator::setShard(int index, int count)
+{
+    m_d->shardCount = qMax(count, 1);
+    m_d->shardIndex = qBound(1, index, m_d->shardCount);
+}
+
+int Generator::shardIndex() const
+{
+    return m_d->shardIndex;
+}
+
+int Generator::shardCount() const
+{
+    return m_d->shardCount;
+}
+
+void Generator::setMergeShards(bool merge)
+{
+    m_d->mergeShards = merge;
+}
+
+void Generator::setMemoryLimit(qint64 bytes)
+{
+    m_d->memoryLimit = qMax(bytes, qint64(0));
+}
+
+qint64 Generator::memoryLimit() const
+{
+    return m_d->memoryLimit;
+}
+
+QString Generator::stateFileName(const QString& extension) const
+{
+    return m_d->outDir + "/." + stateName() + '.' + extension;
+}
+
+QMap<QString, QString> Generator::outputArguments(const QMap<QString, QString>& args)
+{
+    static const char* runnerOptions[] = {
+        "batch-file", "batch-jobs", "debug-level", "help", "incremental", "jobs", "memory-limit",
+        "merge-shards", "no-suppress-warnings", "parallel-generators", "profile", "project-file",
+        "shard", "silent", 0
+    };
+    QMap<QString, QString> result = args;
+    for (int i = 0; runnerOptions[i]; ++i)
+        result.remove(runnerOptions[i]);
+    return result;
+}
+
+static void fillTypeCaches(const AbstractMetaType* type)
+{
+    if (!type)
+        return;
+    type->cppSignature();
+    fillTypeCaches(type->arrayElementType());
+    fillTypeCaches(type->originalTemplateType());
+    foreach (const AbstractMetaType* instantiation, type->instantiations())
+        fillTypeCaches(instantiation);
+}
+
+static void fillFunctionCaches(const AbstractMetaFunction* func)
+{
+    func->minimalSignature();
+    func->modifiedName();
+    fillTypeCaches(func->type());
+    foreach (const AbstractMetaArgument* arg, func->arguments())
+        fillTypeCaches(arg->type());
+}
+
+void Generator::fillModelCaches(const ApiExtractor& extractor)
+{
+    ProfileScope scope("generatorrunner", "fillModelCaches");
+    // Inherited functions are listed by each class, so base class functions are covered too.
+    foreach (const AbstractMetaClass* metaClass, extractor.classes()) {
+        foreach (const AbstractMetaFunction* func, metaClass->functions())
+            fillFunctionCaches(func);
+        foreach (const AbstractMetaField* field, metaClass->fields())
+            fillTypeCaches(field->type());
+    }
+    foreach (const AbstractMetaFunction* func, extractor.globalFunctions())
+        fillFunctionCaches(func);
+}
+
+QString Generator::stateName() const
+{
+    // The shards of a split may share the output directory.
+    if (m_d->shardCount > 1)
+        return name() + GeneratorShards::shardSuffix(m_d->shardIndex, m_d->shardCount);
+    return name();
+}
+
+static void addFingerprintData(QCryptographicHash& hash, const QString& data)
+{
+    hash.addData(data.toUtf8());
+    hash.addData("", 1);
+}
+
+static void addFingerprintData(QCryptographicHash& hash, const CodeSnipList& codeSnips)
+{
+    foreach (CodeSnip snip, codeSnips) {
+        addFingerprintData(hash, QString("snip %1 %2").arg(snip.position).arg(snip.language));
+        addFingerprintData(hash, snip.code());
+    }
+}
+
+static void addFingerprintData(QCryptographicHash& hash, const AbstractMetaType* type)
+{
+    addFingerprintData(hash, type ? type->cppSignature() : QString("void"));
+}
+
+QByteArray Generator::classFingerprint(const AbstractMetaClass* metaClass) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    addFingerprintData(hash, metaClass->qualifiedCppName());
+    addFingerprintData(hash, metaClass->package());
+    if (metaClass->enclosingClass())
+        addFingerprintData(hash, metaClass->enclosingClass()->qualifiedCppName());
+    addFingerprintData(hash, metaClass->baseClassNames().join(","));
+    for (const AbstractMetaClass* base = metaClass->baseClass(); base; base = base->baseClass())
+        addFingerprintData(hash, base->qualifiedCppName());
+
+    addFingerprintData(hash, QString("entry %1 %2").arg(metaClass->typeEntry()->codeGeneration())
+                                                   .arg(metaClass->typeEntry()->version()));
+    addFingerprintData(hash, metaClass->typeEntry()->codeSnips());
+    foreach (DocModification mod, metaClass->typeEntry()->docModifications()) {
+        addFingerprintData(hash, QString("doc %1 %2").arg(mod.mode()).arg(mod.format));
+        addFingerprintData(hash, mod.signature());
+        addFingerprintData(hash, mod.code());
+    }
+
+    foreach (const AbstractMetaFunction* func, metaClass->functions()) {
+        addFingerprintData(hash, QString("function %1 %2").arg(func->attributes()).arg(func->isModifiedRemoved()));
+        addFingerprintData(hash, func->name());
+        addFingerprintData(hash, func->minimalSignature());
+        addFingerprintData(hash, func->type());
+        foreach (const AbstractMetaArgument* arg, func->arguments()) {
+            addFingerprintData(hash, arg->name());
+            addFingerprintData(hash, arg->type());
+            addFingerprintData(hash, arg->defaultValueExpression());
+            addFingerprintData(hash, QString::number(func->argumentRemoved(arg->argumentIndex() + 1)));
+        }
+        foreach (FunctionModification mod, func->modifications()) {
+            foreach (ArgumentModification argMod, mod.argument_mods) {
+                addFingerprintData(hash, QString::number(argMod.index));
+                addFingerprintData(hash, argMod.modified_type);
+            }
+        }
+        addFingerprintData(hash, func->injectedCodeSnips());
+    }
+
+    foreach (const AbstractMetaEnum* metaEnum, metaClass->enums()) {
+        addFingerprintData(hash, metaEnum->name());
+        foreach (const AbstractMetaEnumValue* value, metaEnum->values())
+            addFingerprintData(hash, QString("%1=%2").arg(value->name()).arg(value->value()));
+    }
+
+    foreach (const AbstractMetaField* field, metaClass->fields()) {
+        addFingerprintData(hash, field->name());
+        addFingerprintData(hash, field->type());
+    }
+
+    return hash.result();
+}
+
 void Generator::generate()
 {
-    foreach (AbstractMetaClass *cls, m_d->apiextractor->classes()) {
+    ProfileScope scope(name(), "generate");
+    m_d->failed = false;
+    if (m_d->mergeShards) {
+        m_d->failed = !mergeShards();
+        if (!m_d->failed)
+            saveGenerationState();
+        return;
+    }
+
+    bool parallel = m_d->numberOfJobs > 1 && (capabilities() & ThreadSafeClassGeneration);
+    QThreadPool pool;
+    pool.setMaxThreadCount(m_d->numberOfJobs);
+    // The workers reach the same functions and types, e.g. those of base classes.
+    if (parallel)
+        fillModelCaches(*m_d->apiextractor);
+
+    // Outputs are committed in class order, and only a few of them are kept
+    // waiting for commit while the workers go ahead with the next classes.
+    // With a memory limit only the classes being generated are kept.
+    int maxPending = parallel ? m_d->numberOfJobs * (m_d->memoryLimit ? 1 : 4) : 0;
+    QQueue<GenerationTask*> pending;
+    // Buffers start with room for the average output so far, plus some slack.
+    qint64 totalOutputSize = 0;
+    int outputs = 0;
+    // Files are compared with the previous output and written by a background thread.
+    OutputWriter writer(outputDirectory(), stateName());
+    typedef QPair<QString, QByteArray> CacheEntry;
+    QList<CacheEntry> cacheEntries;
+
+    // The incremental cache is keyed on the class fingerprint mixed with everything
+    // else given to the generator in this run that may change its output.
+    GeneratorCache cache(outputDirectory(), stateName());
+    GeneratorCache* usedCache = 0;
+    QByteArray runFingerprint;
+    if (m_d->incremental && (capabilities() & IncrementalGeneration)) {
+        cache.load();
+        usedCache = &cache;
+
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        addFingerprintData(hash, GENERATORRUNNER_VERSION);
+        addFingerprintData(hash, name());
+        hash.addData(m_d->buildId);
+        addFingerprintData(hash, m_d->licenseComment);
+        QMap<QString, QString> args = outputArguments(m_d->args);
+        QMap<QString, QString>::const_iterator it = args.constBegin();
+        for (; it != args.constEnd(); ++it) {
+            addFingerprintData(hash, it.key());
+            addFingerprintData(hash, it.value());
+        }
+        runFingerprint = hash.result();
+    }
+
+    bool hooks = capabilities() & GenerationHooks;
+
+    // The costs measured by the last complete run balance the shards.
+    GeneratorShards shards(outputDirectory(), name());
+    shards.loadCosts();
+    bool sharded = m_d->shardCount > 1;
+    QSet<QString> shardClasses;
+    if (sharded) {
+        // The classes of a batch stay together when the generator works on batches.
+        QList<QStringList> groups;
+        QHash<const AbstractMetaClass*, int> groupIndexes;
+        QHash<QString, int> estimates;
+        foreach (AbstractMetaClass* cls, m_d->classes) {
+            if (!shouldGenerate(cls))
+                continue;
+            QString className = cls->qualifiedCppName();
+            if (!hooks) {
+                groups << QStringList(className);
+                continue;
+            }
+            const AbstractMetaClass* outermost = outermostClass(cls);
+            if (!groupIndexes.contains(outermost)) {
+                groupIndexes.insert(outermost, groups.size());
+                groups << QStringList();
+            }
+            groups[groupIndexes.value(outermost)] << className;
+            estimates.insert(className, classCost(cls));
+        }
+        shardClasses = shards.shardClasses(groups, estimates, m_d->shardIndex, m_d->shardCount);
+    }
+
+    QList<PlannedClass> planned;
+    foreach (AbstractMetaClass *cls, m_d->classes) {
         if (!shouldGenerate(cls))
             continue;
 
+        if (sharded && !shardClasses.contains(cls->qualifiedCppName()))
+            continue;
+
         QString fileName = fileNameForClass(cls);
         if (fileName.isNull())
             continue;
-        ReportHandler::debugSparse(QString("generating: %1").arg(fileName));
 
-        FileOut fileOut(outputDirectory() + '/' + subDirectoryForClass(cls) + '/' + fileName);
-        generateClass(fileOut.stream, cls);
+        PlannedClass entry;
+        entry.metaClass = cls;
+        entry.outermost = outermostClass(cls);
+        entry.fileName = fileName;
+        entry.filePath = subDirectoryForClass(cls) + '/' + fileName;
+        entry.upToDate = false;
+        if (usedCache) {
+            entry.fingerprint = runFingerprint + classFingerprint(cls);
+            entry.upToDate = usedCache->isUpToDate(entry.filePath, entry.fingerprint);
+        }
+        planned << entry;
+    }
+
+    // The limit bounds what generation adds to the process, not the model it starts with.
+    // Freed memory doesn't always go back to the system, so after writing out the pending
+    // classes the process must grow by another quarter of the limit before it's done again.
+    qint64 drainThreshold = 0;
+    if (m_d->memoryLimit)
+        drainThreshold = Profiler::residentMemory() + m_d->memoryLimit;
+
+    AbstractMetaClassList batch;
+    for (int i = 0; i < planned.size(); ++i) {
+        const PlannedClass& entry = planned[i];
+        {
+            QMutexLocker locker(&reportHandlerMutex());
+            ReportHandler::debugSparse(QString(entry.upToDate ? "up to date: %1" : "generating: %1").arg(entry.fileName));
+        }
 
-        if (fileOut.done())
-            ++m_d->numGeneratedWritten;
-        ++m_d->numGenerated;
+        // A batch is a run of consecutive classes with the same outermost class.
+        bool batchBegins = i == 0 || planned[i - 1].outermost != entry.outermost;
+        bool batchEnds = i + 1 == planned.size() || planned[i + 1].outermost != entry.outermost;
+        if (hooks && batchBegins) {
+            batch.clear();
+            for (int j = i; j < planned.size() && planned[j].outermost == entry.outermost; ++j) {
+                if (!planned[j].upToDate)
+                    batch << planned[j].metaClass;
+            }
+            if (!batch.isEmpty())
+                beginBatch(batch);
+        }
+
+        if (m_d->memoryLimit && Profiler::residentMemory() > drainThreshold) {
+            // Every output still in memory is written before generating more.
+            while (!pending.isEmpty()) {
+                GenerationTask* task = pending.dequeue();
+                task->commit(&writer, &shards);
+                delete task;
+            }
+            writer.waitForDone();
+#ifdef __GLIBC__
+            // Hands the freed memory back to the system, so that it stops counting as resident.
+            malloc_trim(0);
+#endif
+            drainThreshold = qMax(drainThreshold, Profiler::residentMemory() + m_d->memoryLimit / 4);
+        }
+
+        int sizeHint = outputs ? totalOutputSize / outputs * 5 / 4 : 0;
+        GenerationTask* task = new GenerationTask(this, entry.metaClass, entry.filePath, entry.upToDate, sizeHint);
+        if (hooks && batchEnds)
+            task->endOfBatch = batch;
+        pending.enqueue(task);
+        if (parallel && !entry.upToDate)
+            pool.start(task);
+        else
+            task->run();
+
+        while (pending.size() > maxPending) {
+            task = pending.dequeue();
+            task->commit(&writer, &shards);
+            if (!task->upToDate) {
+                totalOutputSize += task->buffer.size();
+                ++outputs;
+            }
+            delete task;
+        }
+        if (usedCache)
+            cacheEntries << qMakePair(entry.filePath, entry.fingerprint);
+    }
+
+    while (!pending.isEmpty()) {
+        GenerationTask* task = pending.dequeue();
+        task->commit(&writer, &shards);
+        delete task;
+    }
+
+    // The cache records the files as they are on disk once everything was written.
+    {
+        ProfileScope writeScope(name(), "write output");
+        m_d->numGeneratedWritten += writer.numWritten();
+    }
+    foreach (const CacheEntry& entry, cacheEntries)
+        usedCache->insert(entry.first, entry.second);
+
+    if (usedCache && !usedCache->save()) {
+        QMutexLocker locker(&reportHandlerMutex());
+        ReportHandler::warning("Couldn't write the incremental generation cache of " + QString(name()));
+    }
+
+    if (sharded) {
+        if (!shards.saveShard(m_d->shardIndex, m_d->shardCount)) {
+            QMutexLocker locker(&reportHandlerMutex());
+            ReportHandler::warning(QString("Couldn't record shard %1 of %2 of %3")
+                                   .arg(m_d->shardIndex).arg(m_d->shardCount).arg(name()));
+            m_d->failed = true;
+        }
+        saveGenerationState();
+        return;
+    }
+    if (!shards.saveCosts()) {
+        QMutexLocker locker(&reportHandlerMutex());
+        ReportHandler::warning("Couldn't write the class generation costs of " + QString(name()));
     }
+    {
+        ProfileScope finishScope(name(), "finishGeneration");
+        finishGeneration();
+    }
+    saveGenerationState();
+}
+
+bool Generator::generationFailed() const
+{
+    return m_d->failed;
+}
+
+bool Generator::mergeShards()
+{
+    GeneratorShards shards(outputDirectory(), name());
+    shards.loadCosts();
+    QSet<QString> classNames;
+    QString errorMessage;
+    if (shards.loadShards(&classNames, &errorMessage)) {
+        // Together the shards must have generated the classes a complete run would.
+        QSet<QString> expected;
+        foreach (AbstractMetaClass* cls, m_d->classes) {
+            if (shouldGenerate(cls) && !fileNameForClass(cls).isNull())
+                expected << cls->qualifiedCppName();
+        }
+        QStringList missing = QSet<QString>(expected).subtract(classNames).toList();
+        QStringList unknown = QSet<QString>(classNames).subtract(expected).toList();
+        qSort(missing);
+        qSort(unknown);
+        if (!missing.isEmpty())
+            errorMessage = QString("%1 classes weren't generated by any shard, e.g. %2").arg(missing.size()).arg(missing.first());
+        else if (!unknown.isEmpty())
+            errorMessage = QString("the shards generated %1 classes unknown to this run, e.g. %2").arg(unknown.size()).arg(unknown.first());
+    }
+    if (!errorMessage.isEmpty()) {
+        QMutexLocker locker(&reportHandlerMutex());
+        ReportHandler::warning("Can't merge the shards of " + QString(name()) + ": " + errorMessage);
+        return false;
+    }
+
+    // The same calls, in the same order, made by a run generating every class.
+    foreach (AbstractMetaClass* cls, m_d->classes) {
+        if (classNames.contains(cls->qualifiedCppName()))
+            classGenerated(cls);
+    }
+
+    if (!shards.saveCosts()) {
+        QMutexLocker locker(&reportHandlerMutex());
+        ReportHandler::warning("Couldn't write the class generation costs of " + QString(name()));
+    }
+    ProfileScope finishScope(name(), "finishGeneration");
     finishGeneration();
+    return true;
+}
+
+void Generator::classGenerated(const AbstractMetaClass*)
+{
+}
+
+void Generator::beginBatch(const AbstractMetaClassList&)
+{
+}
+
+void Generator::endBatch(const AbstractMetaClassList&)
+{
+}
+
+int Generator::classCost(const AbstractMetaClass*) const
+{
+    return 1;
+}
+
+void Generator::saveGenerationState()
+{
 }
 
 bool Generator::shouldGenerate(const AbstractMetaClass* metaClass) const
@@ -198,6 +847,12 @@ bool Generator::shouldGenerate(const AbstractMetaClass* metaClass) const
     return metaClass->typeEntry()->codeGeneration() & TypeEntry::GenerateTargetLang;
 }
 
+QMutex& reportHandlerMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
 void verifyDirectoryFor(const QFile &file)
 {
     QDir dir = QFileInfo(file).dir();
@@ -208,65 +863,157 @@ void verifyDirectoryFor(const QFile &file)
     }
 }
 
+// Tells if code has the given ASCII word at position pos.
+static bool hasWordAt(const QString& code, int pos, const char* word)
+{
+    for (; *word; ++word, ++pos) {
+        if (pos >= code.size() || code.at(pos) != QLatin1Char(*word))
+            return false;
+    }
+    return true;
+}
+
 void Generator::replaceTemplateVariables(QString &code, const AbstractMetaFunction *func)
 {
+    int pos = code.indexOf('%');
+    if (pos == -1)
+        return;
+
     const AbstractMetaClass *cpp_class = func->ownerClass();
-    if (cpp_class)
-        code.replace("%TYPE", cpp_class->name());
 
-    foreach (AbstractMetaArgument *arg, func->arguments())
-        code.replace("%" + QString::number(arg->argumentIndex() + 1), arg->name());
+    QVector<QString> argumentNames;
+    QVector<bool> hasArgument;
+    foreach (AbstractMetaArgument *arg, func->arguments()) {
+        int index = arg->argumentIndex() + 1;
+        if (index >= argumentNames.size()) {
+            argumentNames.resize(index + 1);
+            hasArgument.resize(index + 1);
+        }
+        if (!hasArgument[index]) {
+            argumentNames[index] = arg->name();
+            hasArgument[index] = true;
+        }
+    }
 
-    //template values
-    code.replace("%RETURN_TYPE", translateType(func->type(), cpp_class));
-    code.replace("%FUNCTION_NAME", func->originalName());
+    // Each value is computed the first time it is used.
+    enum { ClassName, ReturnType, FunctionName, ArgumentNames, Arguments, NumberOfValues };
+    QString values[NumberOfValues];
+    bool computed[NumberOfValues] = { false, false, false, false, false };
+
+    QString result;
+    result.reserve(code.size() + code.size() / 4);
+    int literalStart = 0;
+    for (; pos != -1; pos = code.indexOf('%', pos)) {
+        int next = pos + 1;
+        const QString* value = 0;
+        int length = 0;
+        int valueId = NumberOfValues;
+
+        if (cpp_class && hasWordAt(code, next, "TYPE")) {
+            valueId = ClassName;
+            length = sizeof("TYPE") - 1;
+        } else if (next < code.size() && code.at(next) >= QLatin1Char('1') && code.at(next) <= QLatin1Char('9')) {
+            // %1 used to be replaced before %12 was tried, so the shortest argument number wins.
+            int index = 0;
+            for (int i = next; i < code.size() && code.at(i) >= QLatin1Char('0') && code.at(i) <= QLatin1Char('9'); ++i) {
+                index = index * 10 + code.at(i).unicode() - '0';
+                if (index >= argumentNames.size())
+                    break;
+                if (hasArgument[index]) {
+                    value = &argumentNames[index];
+                    length = i - next + 1;
+                    break;
+                }
+            }
+        } else if (hasWordAt(code, next, "RETURN_TYPE")) {
+            valueId = ReturnType;
+            length = sizeof("RETURN_TYPE") - 1;
+        } else if (hasWordAt(code, next, "FUNCTION_NAME")) {
+            valueId = FunctionName;
+            length = sizeof("FUNCTION_NAME") - 1;
+        } else if (hasWordAt(code, next, "ARGUMENT_NAMES")) {
+            valueId = ArgumentNames;
+            length = sizeof("ARGUMENT_NAMES") - 1;
+        } else if (hasWordAt(code, next, "ARGUMENTS")) {
+            valueId = Arguments;
+            length = sizeof("ARGUMENTS") - 1;
+        }
 
-    if (code.contains("%ARGUMENT_NAMES")) {
-        QString str;
-        QTextStream aux_stream(&str);
-        writeArgumentNames(aux_stream, func, Generator::SkipRemovedArguments);
-        code.replace("%ARGUMENT_NAMES", str);
+        if (valueId != NumberOfValues) {
+            if (!computed[valueId]) {
+                QString& str = values[valueId];
+                if (valueId == ClassName) {
+                    str = cpp_class->name();
+                } else if (valueId == ReturnType) {
+                    str = translateType(func->type(), cpp_class);
+                } else if (valueId == FunctionName) {
+                    str = func->originalName();
+                } else {
+                    QTextStream aux_stream(&str);
+                    if (valueId == ArgumentNames)
+                        writeArgumentNames(aux_stream, func, Generator::SkipRemovedArguments);
+                    else
+                        writeFunctionArguments(aux_stream, func, Options(SkipDefaultValues) | SkipRemovedArguments);
+                }
+                computed[valueId] = true;
+            }
+            value = &values[valueId];
+        }
+
+        if (!value) {
+            pos = next;
+            continue;
+        }
+
+        result += code.midRef(literalStart, pos - literalStart);
+        result += *value;
+        pos = next + length;
+        literalStart = pos;
     }
 
-    if (code.contains("%ARGUMENTS")) {
-        QString str;
-        QTextStream aux_stream(&str);
-        writeFunctionArguments(aux_stream, func, Options(SkipDefaultValues) | SkipRemovedArguments);
-        code.replace("%ARGUMENTS", str);
+    if (literalStart) {
+        result += code.midRef(literalStart);
+        code = result;
     }
 }
 
 QTextStream& formatCode(QTextStream &s, const QString& code, Indentor &indentor)
 {
+    const QChar* data = code.constData();
+    const int size = code.size();
+
     // detect number of spaces before the first character
-    QStringList lst(code.split("\n"));
-    QRegExp nonSpaceRegex("[^\\s]");
     int spacesToRemove = 0;
-    foreach(QString line, lst) {
-        if (!line.trimmed().isEmpty()) {
-            spacesToRemove = line.indexOf(nonSpaceRegex);
-            if (spacesToRemove == -1)
-                spacesToRemove = 0;
+    int lineStart = 0;
+    for (int i = 0; i < size; ++i) {
+        if (data[i] == '\n') {
+            lineStart = i + 1;
+        } else if (!data[i].isSpace()) {
+            spacesToRemove = i - lineStart;
             break;
         }
     }
 
-    static QRegExp emptyLine("\\s*[\\r]?[\\n]?\\s*");
+    int begin = 0;
+    while (true) {
+        int end = code.indexOf(QLatin1Char('\n'), begin);
+        if (end == -1)
+            end = size;
 
-    foreach(QString line, lst) {
-        if (!line.isEmpty() && !emptyLine.exactMatch(line)) {
-            while (line.end()->isSpace())
-                line.chop(1);
-            int limit = 0;
-            for(int i = 0; i < spacesToRemove; ++i) {
-                if (!line[i].isSpace())
-                    break;
-                limit++;
-            }
+        int firstChar = begin;
+        while (firstChar < end && data[firstChar].isSpace())
+            ++firstChar;
 
-            s << indentor << line.remove(0, limit);
+        // lines with only blanks are written as empty lines
+        if (firstChar < end) {
+            int start = begin + qMin(firstChar - begin, spacesToRemove);
+            s << indentor << QString::fromRawData(data + start, end - start);
         }
         s << endl;
+
+        if (end == size)
+            break;
+        begin = end + 1;
     }
     return s;
 }
@@ -274,7 +1021,7 @@ QTextStream& formatCode(QTextStream &s, const QString& code, Indentor &indentor)
 AbstractMetaFunctionList Generator::implicitConversions(const TypeEntry* type) const
 {
     if (type->isValue()) {
-        const AbstractMetaClass* metaClass = classes().findClass(type);
+        const AbstractMetaClass* metaClass = findAbstractMetaClass(type);
         if (metaClass)
             return metaClass->implicitConversions();
     }
@@ -312,7 +1059,25 @@ bool Generator::isPointer(const AbstractMetaType* type)
             || type->isValuePointer();
 }
 
+/**
+*   The classes whose minimal constructor is being searched, a class needing
+*   itself through the arguments of its constructors can't be built this way.
+*   cycles counts the times that happened.
+*/
+struct Generator::MinimalConstructorSearch
+{
+    MinimalConstructorSearch() : cycles(0) {}
+    QSet<const TypeEntry*> visited;
+    int cycles;
+};
+
 QString Generator::minimalConstructor(const AbstractMetaType* type) const
+{
+    MinimalConstructorSearch search;
+    return minimalConstructor(type, search);
+}
+
+QString Generator::minimalConstructor(const AbstractMetaType* type, MinimalConstructorSearch& search) const
 {
     if (!type || (type->isReference() && Generator::isObjectType(type)))
         return QString();
@@ -339,7 +1104,7 @@ QString Generator::minimalConstructor(const AbstractMetaType* type) const
     if (type->typeEntry()->isComplex()) {
         const ComplexTypeEntry* cType = reinterpret_cast<const ComplexTypeEntry*>(type->typeEntry());
         QString ctor = cType->defaultConstructor();
-        return (ctor.isEmpty()) ? minimalConstructor(classes().findClass(cType)) : ctor;
+        return (ctor.isEmpty()) ? minimalConstructor(findAbstractMetaClass(cType), search) : ctor;
     }
 
     return minimalConstructor(type->typeEntry());
@@ -369,10 +1134,45 @@ QString Generator::minimalConstructor(const TypeEntry* type) const
 }
 
 QString Generator::minimalConstructor(const AbstractMetaClass* metaClass) const
+{
+    MinimalConstructorSearch search;
+    return minimalConstructor(metaClass, search);
+}
+
+QString Generator::minimalConstructor(const AbstractMetaClass* metaClass, MinimalConstructorSearch& search) const
 {
     if (!metaClass)
         return QString();
 
+    const TypeEntry* typeEntry = metaClass->typeEntry();
+    {
+        QMutexLocker locker(&m_d->minimalConstructorsMutex);
+        QHash<const TypeEntry*, QString>::const_iterator it = m_d->minimalConstructors.find(typeEntry);
+        if (it != m_d->minimalConstructors.constEnd())
+            return it.value();
+    }
+
+    if (search.visited.contains(typeEntry)) {
+        ++search.cycles;
+        return QString();
+    }
+
+    int cycles = search.cycles;
+    search.visited.insert(typeEntry);
+    QString ctor = findMinimalConstructor(metaClass, search);
+    search.visited.remove(typeEntry);
+
+    // A result that gave up on a class still being searched depends on where
+    // the search started, only the outermost one is kept.
+    if (search.cycles == cycles || search.visited.isEmpty()) {
+        QMutexLocker locker(&m_d->minimalConstructorsMutex);
+        m_d->minimalConstructors.insert(typeEntry, ctor);
+    }
+    return ctor;
+}
+
+QString Generator::findMinimalConstructor(const AbstractMetaClass* metaClass, MinimalConstructorSearch& search) const
+{
     const ComplexTypeEntry* cType = reinterpret_cast<const ComplexTypeEntry*>(metaClass->typeEntry());
     if (cType->hasDefaultConstructor())
         return cType->defaultConstructor();
@@ -425,7 +1225,7 @@ QString Generator::minimalConstructor(const AbstractMetaClass* metaClass) const
                 }
 
                 if (type->isCppPrimitive() || type->isEnum() || isPointer(arg->type())) {
-                    QString argValue = minimalConstructor(arg->type());
+                    QString argValue = minimalConstructor(arg->type(), search);
                     if (argValue.isEmpty()) {
                         args.clear();
                         break;
@@ -456,7 +1256,7 @@ QString Generator::minimalConstructor(const AbstractMetaClass* metaClass) const
                 args.clear();
                 break;
             }
-            QString argValue = minimalConstructor(arg->type());
+            QString argValue = minimalConstructor(arg->type(), search);
             if (argValue.isEmpty()) {
                 args.clear();
                 break;
@@ -472,6 +1272,48 @@ QString Generator::minimalConstructor(const AbstractMetaClass* metaClass) const
     return QString();
 }
 
+static QString copiedCppSignature(const AbstractMetaType* cType, Generator::Options options)
+{
+    AbstractMetaType* copyType = cType->copy();
+
+    if (options & Generator::ExcludeConst)
+        copyType->setConstant(false);
+
+    if (options & Generator::ExcludeReference)
+        copyType->setReference(false);
+
+    QString s = copyType->cppSignature();
+    delete copyType;
+    return s;
+}
+
+/**
+*   Returns the signature that cType would have without the const and/or reference
+*   flags excluded by options. The type's own cached signature is trimmed instead
+*   of building it again for a modified copy of the type.
+*/
+static QString strippedCppSignature(const AbstractMetaType* cType, Generator::Options options)
+{
+    QString s = cType->cppSignature();
+
+    if ((options & Generator::ExcludeConst) && cType->isConstant()) {
+        if (!s.startsWith("const "))
+            return copiedCppSignature(cType, options);
+        s.remove(0, sizeof("const ") - 1);
+    }
+
+    if ((options & Generator::ExcludeReference) && cType->isReference()) {
+        if (!s.endsWith('&'))
+            return copiedCppSignature(cType, options);
+        s.chop(1);
+        // Without indirections, nothing else follows the space after the type name.
+        if (!cType->indirections() && s.endsWith(' '))
+            s.chop(1);
+    }
+
+    return s;
+}
+
 QString Generator::translateType(const AbstractMetaType *cType,
                                  const AbstractMetaClass *context,
                                  Options options) const
@@ -505,18 +1347,9 @@ QString Generator::translateType(const AbstractMetaType *cType,
                     s = s.remove(index, constLen);
             }
         } else if (options & Generator::ExcludeConst || options & Generator::ExcludeReference) {
-            AbstractMetaType* copyType = cType->copy();
-
-            if (options & Generator::ExcludeConst)
-                copyType->setConstant(false);
-
-            if (options & Generator::ExcludeReference)
-                copyType->setReference(false);
-
-            s = copyType->cppSignature();
-            if (!copyType->typeEntry()->isVoid() && !copyType->typeEntry()->isCppPrimitive())
+            s = strippedCppSignature(cType, options);
+            if (!cType->typeEntry()->isVoid() && !cType->typeEntry()->isCppPrimitive())
                 s.prepend("::");
-            delete copyType;
         } else {
             s = cType->cppSignature();
         }
@@ -541,16 +1374,24 @@ QString Generator::subDirectoryForPackage(QString packageName) const
 template<typename T>
 static QString getClassTargetFullName_(const T* t, bool includePackageName)
 {
-    QString name = t->name();
-    const AbstractMetaClass* context = t->enclosingClass();
-    while (context) {
-        name.prepend('.');
-        name.prepend(context->name());
-        context = context->enclosingClass();
-    }
-    if (includePackageName) {
-        name.prepend('.');
-        name.prepend(t->package());
+    // The parts are gathered first so the name is built in a single allocation.
+    QVarLengthArray<QString, 8> parts;
+    parts.append(t->name());
+    for (const AbstractMetaClass* context = t->enclosingClass(); context; context = context->enclosingClass())
+        parts.append(context->name());
+    if (includePackageName)
+        parts.append(t->package());
+
+    int length = parts.size() - 1;
+    for (int i = 0; i < parts.size(); ++i)
+        length += parts[i].size();
+
+    QString name;
+    name.reserve(length);
+    for (int i = parts.size() - 1; i >= 0; --i) {
+        name += parts[i];
+        if (i)
+            name += '.';
     }
     return name;
 }
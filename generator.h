@@ -33,8 +33,20 @@
 class ApiExtractor;
 class AbstractMetaBuilder;
 class QFile;
+class QMutex;
+
+/**
+ *   Version of the binary interface between generatorrunner and the generator plugins,
+ *   raised whenever the virtual table or the layout of Generator changes. Plugins
+ *   built for another version are rejected, they must be rebuilt against this header.
+ */
+#define GENERATOR_PLUGIN_ABI_VERSION 3
 
 #define EXPORT_GENERATOR_PLUGIN(X)\
+extern "C" GENRUNNER_EXPORT int generatorPluginAbiVersion()\
+{\
+    return GENERATOR_PLUGIN_ABI_VERSION;\
+}\
 extern "C" GENRUNNER_EXPORT void getGenerators(GeneratorList* list)\
 {\
     *list << X;\
@@ -45,9 +57,36 @@ QTextStream& formatCode(QTextStream &s, const QString& code, Indentor &indentor)
 GENRUNNER_API
 void verifyDirectoryFor(const QFile &file);
 
+/**
+ *   Returns the mutex that must be held when using ReportHandler, which is not
+ *   reentrant, from code that may run on a generation worker thread.
+ */
+GENRUNNER_API QMutex& reportHandlerMutex();
+
 GENRUNNER_API QString getClassTargetFullName(const AbstractMetaClass* metaClass, bool includePackageName = true);
 GENRUNNER_API QString getClassTargetFullName(const AbstractMetaEnum* metaEnum, bool includePackageName = true);
 
+/**
+ *   Data derived from the type database that is the same for every generator of
+ *   a run. It is built once, after the ApiExtractor run, and shared read-only by
+ *   all the generators given to it in Generator::setup().
+ */
+class GENRUNNER_API GeneratorRunContext
+{
+public:
+    /// Reads the current contents of the type database.
+    GeneratorRunContext();
+
+    /// Name of the type system being generated, empty if none was found.
+    QString packageName() const
+    {
+        return m_packageName;
+    }
+
+private:
+    QString m_packageName;
+};
+
 /**
  *   Base class for all generators. The default implementations does nothing,
  *   you must subclass this to create your own generators.
@@ -94,15 +133,51 @@ public:
     };
     Q_DECLARE_FLAGS(Options, Option)
 
+    /// Capabilities declared by a generator to the runner
+    enum Capability {
+        NoCapability              = 0x00000000,
+        ThreadSafeClassGeneration = 0x00000001,
+        ReadOnlyModelAccess       = 0x00000002,
+        IncrementalGeneration     = 0x00000004,
+        GenerationHooks           = 0x00000008
+    };
+    Q_DECLARE_FLAGS(Capabilities, Capability)
+
     Generator();
     virtual ~Generator();
 
+    /// Same as the setup() below, with a context made just for this generator.
     bool setup(const ApiExtractor& extractor, const QMap<QString, QString> args);
 
+    /**
+    *   Takes the model from the extractor and calls doSetup() with args.
+    *   \param context data from the type database, shared by all the generators of the run
+    */
+    bool setup(const ApiExtractor& extractor, const QMap<QString, QString> args, const GeneratorRunContext& context);
+
     virtual QMap<QString, QString> options() const;
 
-    /// Returns the classes used to generate the binding code.
-    AbstractMetaClassList classes() const;
+    /**
+    *   Returns the classes used to generate the binding code.
+    *   The list is taken from the ApiExtractor in setup() and is shared, read-only,
+    *   by all the generators of a run, so it can be used without copying it.
+    */
+    const AbstractMetaClassList& classes() const;
+
+    /**
+    *   Returns the classes whose base class is metaClass, in the order of classes().
+    *   Like all the inheritance queries below, it is answered from an index built in setup().
+    */
+    const AbstractMetaClassList& directSubclasses(const AbstractMetaClass* metaClass) const;
+
+    /// Returns the classes that inherit from metaClass, directly or not, in the order of classes().
+    const AbstractMetaClassList& allSubclasses(const AbstractMetaClass* metaClass) const;
+
+    /// Returns the class of classes() using typeEntry, or 0. This is a hash lookup.
+    const AbstractMetaClass* findAbstractMetaClass(const TypeEntry* typeEntry) const;
+
+    /// Returns the first class of classes() with the given unqualified name, or 0. This is a hash lookup.
+    const AbstractMetaClass* findAbstractMetaClassByName(const QString& name) const;
 
     /// Returns all global functions found by APIExtractor
     AbstractMetaFunctionList globalFunctions() const;
@@ -142,12 +217,132 @@ public:
     */
     void generate();
 
+    /**
+    *   Returns true if the last generate() couldn't complete, e.g. because the shards
+    *   to merge didn't match the classes; the reason was reported as a warning.
+    */
+    bool generationFailed() const;
+
     /// Returns the number of generated items
     int numGenerated() const;
 
     /// Returns the number of generated items written
     int numGeneratedAndWritten() const;
 
+    /**
+    *   Sets the maximum number of classes generated at the same time by generate().
+    *   The default value is 1; greater values only take effect if the generator
+    *   declares the ThreadSafeClassGeneration capability.
+    */
+    void setNumberOfJobs(int jobs);
+
+    /// Returns the maximum number of classes generated at the same time.
+    int numberOfJobs() const;
+
+    /**
+    *   Returns the capabilities of the generator, the default implementation returns NoCapability.
+    *
+    *   A generator declaring ThreadSafeClassGeneration lets generate() call generateClass()
+    *   for different classes at the same time, from worker threads, each one with its own
+    *   output stream. Such a generator must follow these rules inside generateClass():
+    *   - write only to the received stream and do not modify state shared between classes;
+    *     data needed by finishGeneration() must be collected in classGenerated();
+    *   - hold reportHandlerMutex() while using ReportHandler;
+    *   - use only reentrant helpers, as the ApiExtractor model is shared by all workers;
+    *     the caches its const getters fill on first use are filled before generate()
+    *     starts the workers, see fillModelCaches().
+    *
+    *   A generator declaring ReadOnlyModelAccess promises not to modify the ApiExtractor
+    *   model (classes, functions, type entries and their documentation), allowing the
+    *   runner to execute its generate() at the same time as other such generators. The
+    *   rules about ReportHandler above apply to the whole generate() in this case. The
+    *   runner calls fillModelCaches() before, so that the const getters caching their
+    *   results in the model may be used; other lazily filled data must not be.
+    *
+    *   A generator declaring IncrementalGeneration guarantees that the output of
+    *   generateClass() depends only on the data covered by classFingerprint(), so
+    *   generate() can skip classes whose fingerprint didn't change since the last run.
+    *
+    *   A generator declaring GenerationHooks has beginBatch(), endBatch() and classCost()
+    *   called by generate(). Generators that don't declare it keep the behaviour they had
+    *   before these hooks existed, once rebuilt against this header.
+    */
+    virtual Capabilities capabilities() const;
+
+    /**
+    *   Enables or disables the incremental generation cache, stored in the output directory.
+    *   It is only used by generators declaring the IncrementalGeneration capability.
+    *   \param enable true to skip the generation of classes that didn't change
+    *   \param buildId data identifying the generator build, e.g. the time stamp of its
+    *   plugin, so that cached results are discarded when the generator itself changes
+    */
+    void setIncrementalGeneration(bool enable, const QByteArray& buildId = QByteArray());
+
+    /**
+    *   Returns true if incremental generation was enabled. Besides the class cache used by
+    *   generate(), generators may use it to keep caches of their own in the output directory.
+    */
+    bool incrementalGeneration() const;
+
+    /// Returns the build id given to setIncrementalGeneration().
+    QByteArray buildId() const;
+
+    /**
+    *   Makes generate() produce only shard index of count, counted from 1, of the
+    *   classes, and record them in the output directory instead of calling
+    *   finishGeneration(), which is left to a run merging all the shards.
+    *   A count of 1, the default, generates every class.
+    */
+    void setShard(int index, int count);
+
+    /// Returns the shard generated, counted from 1.
+    int shardIndex() const;
+
+    /// Returns the number of shards the classes are split into.
+    int shardCount() const;
+
+    /**
+    *   Makes generate() skip the generation of classes. It calls instead classGenerated()
+    *   for each class generated by the shards recorded in the output directory, followed
+    *   by finishGeneration(). The merge fails, see generationFailed(), unless the
+    *   shards together generated each class of a complete run exactly once.
+    */
+    void setMergeShards(bool merge);
+
+    /**
+    *   Bounds the memory used by generate(), in bytes; 0, the default, sets no bound.
+    *   With a limit generate() keeps fewer classes waiting to be written, and when the
+    *   process grew by more than the limit since generate() started it writes out
+    *   every pending class before going on.
+    *   Generators may use memoryLimit() to release their own data sooner.
+    */
+    void setMemoryLimit(qint64 bytes);
+
+    /// Returns the memory limit, 0 if there is none.
+    qint64 memoryLimit() const;
+
+    /**
+    *   Returns the path of a file the generator may keep in the output directory for
+    *   its own use, e.g. a cache. The name depends on the generator and on the shard.
+    */
+    QString stateFileName(const QString& extension) const;
+
+    /**
+    *   Returns args without the options of the runner that only change how the generation
+    *   runs, e.g. jobs or profile, and not what it writes. Caches of generated output are
+    *   keyed on these arguments, so that such options don't invalidate them.
+    */
+    static QMap<QString, QString> outputArguments(const QMap<QString, QString>& args);
+
+    /**
+    *   Fills the caches some const getters of the ApiExtractor model fill on first use,
+    *   e.g. AbstractMetaFunction::minimalSignature() and AbstractMetaType::cppSignature(),
+    *   for the classes and global functions of extractor. Calling those getters from
+    *   several threads is only safe afterwards, as filling a cache writes to the model.
+    *   generate() calls it before generating classes on worker threads.
+    */
+    static void fillModelCaches(const ApiExtractor& extractor);
+
     /// Returns the generator's name. Used for cosmetic purposes.
     virtual const char* name() const = 0;
 
@@ -238,6 +433,7 @@ public:
      *   Tries to build a minimal constructor for the type.
      *   It will check first for a user defined default constructor.
      *   Returns a null string if it fails.
+     *   The constructor found for each class is remembered until the next setup().
      */
     QString minimalConstructor(const TypeEntry* type) const;
     QString minimalConstructor(const AbstractMetaType* type) const;
@@ -251,6 +447,18 @@ protected:
      */
     virtual QString fileNameForClass(const AbstractMetaClass* metaClass) const = 0;
 
+    /**
+     *   Returns a hash of everything in the model that affects the output of
+     *   generateClass() for a class, used by incremental generation.
+     *   The default implementation covers the class type entry, its code and
+     *   documentation modifications, functions, enums, fields and base classes.
+     *   Generators whose output depends on more data must reimplement it,
+     *   mixing the extra data with the default fingerprint.
+     *   The license comment, generator options and build identification are
+     *   added to every fingerprint by generate().
+     */
+    virtual QByteArray classFingerprint(const AbstractMetaClass* metaClass) const;
+
 
     virtual bool doSetup(const QMap<QString, QString>& args) = 0;
 
@@ -261,6 +469,16 @@ protected:
      *   \param  metaClass  the class that should be generated
      */
     virtual void generateClass(QTextStream& s, const AbstractMetaClass* metaClass) = 0;
+
+    /**
+     *   Called by generate() after the output of a class was written.
+     *   It is always called from the thread running generate(), in the same order
+     *   of classes(), no matter how many jobs are used. The default implementation
+     *   does nothing.
+     *   \param metaClass the class that was generated
+     */
+    virtual void classGenerated(const AbstractMetaClass* metaClass);
+
     virtual void finishGeneration() = 0;
 
     /**
@@ -274,12 +492,61 @@ protected:
     */
     virtual QString subDirectoryForPackage(QString packageName = QString()) const;
 
+    // Adding virtual functions changes the plugin ABI, see GENERATOR_PLUGIN_ABI_VERSION:
+    // existing plugin sources still compile unchanged but must be rebuilt.
+
+    /**
+     *   Called by generate(), for generators declaring GenerationHooks, before the
+     *   classes of a batch are generated. A batch holds the classes, in the order of
+     *   classes(), that share their outermost enclosing class and will be generated
+     *   by this run; classes skipped by incremental generation or left to other
+     *   shards are not part of it. It is always called from the thread running
+     *   generate(), but in parallel generation the classes of previous batches may
+     *   still be generated meanwhile. The default implementation does nothing.
+     *   \param classes the classes of the batch
+     */
+    virtual void beginBatch(const AbstractMetaClassList& classes);
+
+    /**
+     *   Called by generate(), for generators declaring GenerationHooks, after
+     *   classGenerated() was called for the last class of a batch. Batches end in
+     *   the order they began. The default implementation does nothing.
+     *   \param classes the classes of the batch, as given to beginBatch()
+     */
+    virtual void endBatch(const AbstractMetaClassList& classes);
+
+    /**
+     *   Returns an estimate, in milliseconds, of the time generateClass() takes for
+     *   metaClass. Generators declaring GenerationHooks are asked for it to split
+     *   the classes among shards when the time measured by a previous run isn't
+     *   known. The default implementation returns 1.
+     */
+    virtual int classCost(const AbstractMetaClass* metaClass) const;
+
+    /**
+     *   Called at the end of every generate(), including the runs generating a shard,
+     *   which don't call finishGeneration(), and after finishGeneration() otherwise.
+     *   Generators save here the state they keep for the next run, e.g. in
+     *   stateFileName(). The default implementation does nothing.
+     */
+    virtual void saveGenerationState();
+
 private:
     struct GeneratorPrivate;
     GeneratorPrivate* m_d;
+    struct GenerationTask;
+
+    struct MinimalConstructorSearch;
+    QString minimalConstructor(const AbstractMetaType* type, MinimalConstructorSearch& search) const;
+    QString minimalConstructor(const AbstractMetaClass* metaClass, MinimalConstructorSearch& search) const;
+    QString findMinimalConstructor(const AbstractMetaClass* metaClass, MinimalConstructorSearch& search) const;
+
+    QString stateName() const;
+    bool mergeShards();
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(Generator::Options)
+Q_DECLARE_OPERATORS_FOR_FLAGS(Generator::Capabilities)
 typedef QLinkedList<Generator*> GeneratorList;
 
 /**
@@ -0,0 +1,107 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "generatorcache.h"
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+
+static const quint32 CACHE_MAGIC = 0x47524300; // "GRC\0"
+static const quint32 CACHE_VERSION = 1;
+
+GeneratorCache::GeneratorCache(const QString& outputDirectory, const QString& generatorName)
+    : m_outputDirectory(outputDirectory),
+      m_fileName(outputDirectory + "/." + generatorName + ".cache")
+{
+}
+
+bool GeneratorCache::load()
+{
+    m_previous.clear();
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_5);
+    quint32 magic;
+    quint32 version;
+    qint32 count;
+    in >> magic >> version >> count;
+    if (magic != CACHE_MAGIC || version != CACHE_VERSION || count < 0)
+        return false;
+
+    for (int i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString filePath;
+        Entry entry;
+        in >> filePath >> entry.fingerprint >> entry.size >> entry.lastModified;
+        m_previous.insert(filePath, entry);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        m_previous.clear();
+        return false;
+    }
+    return true;
+}
+
+bool GeneratorCache::save() const
+{
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << CACHE_MAGIC << CACHE_VERSION << qint32(m_current.count());
+    EntryHash::const_iterator it = m_current.constBegin();
+    for (; it != m_current.constEnd(); ++it)
+        out << it.key() << it.value().fingerprint << it.value().size << it.value().lastModified;
+    return out.status() == QDataStream::Ok;
+}
+
+bool GeneratorCache::isUpToDate(const QString& filePath, const QByteArray& fingerprint) const
+{
+    EntryHash::const_iterator it = m_previous.find(filePath);
+    if (it == m_previous.constEnd() || it.value().fingerprint != fingerprint)
+        return false;
+
+    QFileInfo info(m_outputDirectory + '/' + filePath);
+    return info.exists()
+           && info.size() == it.value().size
+           && info.lastModified().toTime_t() == it.value().lastModified;
+}
+
+void GeneratorCache::insert(const QString& filePath, const QByteArray& fingerprint)
+{
+    QFileInfo info(m_outputDirectory + '/' + filePath);
+    if (!info.exists())
+        return;
+
+    Entry entry;
+    entry.fingerprint = fingerprint;
+    entry.size = info.size();
+    entry.lastModified = info.lastModified().toTime_t();
+    m_current.insert(filePath, entry);
+}
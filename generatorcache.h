@@ -0,0 +1,71 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef GENERATORCACHE_H
+#define GENERATORCACHE_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QString>
+
+/**
+*   Records, in the output directory, the fingerprint of the class used to
+*   generate each file, so that unchanged classes can be skipped by the next run.
+*   File paths are relative to the output directory.
+*/
+class GeneratorCache
+{
+public:
+    GeneratorCache(const QString& outputDirectory, const QString& generatorName);
+
+    /// Reads the entries recorded by the previous run, returns false if there are none.
+    bool load();
+
+    /// Replaces the cache file with the entries inserted during this run.
+    bool save() const;
+
+    /**
+    *   Returns true if the previous run generated filePath from a class with the
+    *   same fingerprint and the file wasn't touched since then.
+    */
+    bool isUpToDate(const QString& filePath, const QByteArray& fingerprint) const;
+
+    /// Records that the current contents of filePath were generated from a class with the given fingerprint.
+    void insert(const QString& filePath, const QByteArray& fingerprint);
+
+private:
+    struct Entry
+    {
+        QByteArray fingerprint;
+        qint64 size;
+        uint lastModified;
+    };
+    typedef QHash<QString, Entry> EntryHash;
+
+    QString m_outputDirectory;
+    QString m_fileName;
+    EntryHash m_previous;
+    EntryHash m_current;
+};
+
+#endif // GENERATORCACHE_H
@@ -0,0 +1,274 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "codesnippetindex.h"
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QList>
+#include <QtCore/QVector>
+#include <cstring>
+
+// Every mapped file keeps a file descriptor open, the files past this
+// limit are read into memory instead.
+static const int MAX_MAPPED_FILES = 256;
+
+struct CodeSnippetIndex::File
+{
+    typedef QPair<int, int> Range;
+
+    QFile file;
+    QByteArray buffer;
+    const char* data;
+    int size;
+    // Line i spans the bytes [lineStarts[i], lineStarts[i + 1]).
+    QVector<int> lineStarts;
+    // Lines where each identifier marker appears for the first and second time, -1 if it doesn't.
+    QHash<QByteArray, Range> markers;
+    // Markers removed from the lines that are part of another snippet, as (offset, length) ranges.
+    QHash<int, QList<Range> > strippedMarkers;
+    QHash<QString, QString> snippets;
+
+    File() : data(""), size(0) {}
+};
+
+static inline bool isMarkerSpace(char c)
+{
+    return QChar(QLatin1Char(c)).isSpace();
+}
+
+// Same characters as "[\w\d\s]" in a QRegExp.
+static inline bool isMarkerIdentifierChar(char c)
+{
+    QChar ch = QLatin1Char(c);
+    return ch.isLetterOrNumber() || ch.isMark() || ch == '_' || ch.isSpace();
+}
+
+CodeSnippetIndex::CodeSnippetIndex() : m_mappedFiles(0), m_avoidedProbes(0)
+{
+}
+
+CodeSnippetIndex::~CodeSnippetIndex()
+{
+    clear();
+}
+
+void CodeSnippetIndex::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    qDeleteAll(m_files);
+    m_files.clear();
+    m_mappedFiles = 0;
+    m_resolvedPaths.clear();
+    m_directoryEntries.clear();
+}
+
+void CodeSnippetIndex::setSearchDirectories(const QStringList& directories)
+{
+    QMutexLocker locker(&m_mutex);
+    m_searchDirectories = directories;
+    m_resolvedPaths.clear();
+}
+
+QString CodeSnippetIndex::findFile(const QString& relativePath)
+{
+    QMutexLocker locker(&m_mutex);
+    QHash<QString, ResolvedPath>::const_iterator it = m_resolvedPaths.find(relativePath);
+    if (it != m_resolvedPaths.constEnd()) {
+        m_avoidedProbes += it.value().second;
+        return it.value().first;
+    }
+
+    ResolvedPath resolved(QString(), 0);
+    foreach (const QString& directory, m_searchDirectories) {
+        QFileInfo info(directory + '/' + relativePath);
+        QString path = QDir::cleanPath(info.path());
+        ++resolved.second;
+        if (m_directoryEntries.contains(path))
+            ++m_avoidedProbes;
+        if (directoryEntries(path).contains(info.fileName())) {
+            resolved.first = info.filePath();
+            break;
+        }
+    }
+    m_resolvedPaths.insert(relativePath, resolved);
+    return resolved.first;
+}
+
+int CodeSnippetIndex::avoidedProbes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_avoidedProbes;
+}
+
+const QSet<QString>& CodeSnippetIndex::directoryEntries(const QString& directory)
+{
+    QHash<QString, QSet<QString> >::iterator it = m_directoryEntries.find(directory);
+    if (it == m_directoryEntries.end()) {
+        // Missing directories are remembered as empty ones.
+        QStringList entries = QDir(directory).entryList(QDir::Files | QDir::Hidden | QDir::System);
+        it = m_directoryEntries.insert(directory, QSet<QString>::fromList(entries));
+    }
+    return it.value();
+}
+
+CodeSnippetIndex::Result CodeSnippetIndex::snippet(const QString& fileName, const QString& identifier, QString* code)
+{
+    QMutexLocker locker(&m_mutex);
+    File* f = file(fileName);
+    if (!f)
+        return FileNotFound;
+
+    if (identifier.isEmpty()) {
+        *code = QString::fromAscii(f->data, f->size);
+        return SnippetFound;
+    }
+
+    QHash<QString, QString>::const_iterator it = f->snippets.find(identifier);
+    if (it != f->snippets.constEnd()) {
+        *code = it.value();
+        return SnippetFound;
+    }
+
+    QByteArray id = identifier.toAscii();
+    if (!f->markers.contains(id))
+        return SnippetNotFound;
+
+    *code = extractSnippet(f, id);
+    f->snippets.insert(identifier, *code);
+    return SnippetFound;
+}
+
+CodeSnippetIndex::File* CodeSnippetIndex::file(const QString& fileName)
+{
+    QHash<QString, File*>::const_iterator it = m_files.find(fileName);
+    if (it != m_files.constEnd())
+        return it.value();
+
+    File* f = new File;
+    f->file.setFileName(fileName);
+    if (!f->file.open(QIODevice::ReadOnly)) {
+        delete f;
+        return 0;
+    }
+
+    const uchar* mapped = 0;
+    if (f->file.size() > 0 && m_mappedFiles < MAX_MAPPED_FILES)
+        mapped = f->file.map(0, f->file.size());
+
+    if (mapped) {
+        f->data = reinterpret_cast<const char*>(mapped);
+        f->size = f->file.size();
+        ++m_mappedFiles;
+    } else {
+        f->buffer = f->file.readAll();
+        f->file.close();
+        f->data = f->buffer.constData();
+        f->size = f->buffer.size();
+    }
+
+    indexFile(f);
+    m_files.insert(fileName, f);
+    return f;
+}
+
+void CodeSnippetIndex::indexFile(File* f)
+{
+    const char* data = f->data;
+    int lineNumber = 0;
+    int begin = 0;
+    while (begin < f->size) {
+        const char* newLine = static_cast<const char*>(std::memchr(data + begin, '\n', f->size - begin));
+        int end = newLine ? newLine - data + 1 : f->size;
+        f->lineStarts << begin;
+
+        // Looks for "//!\s*\[identifier\]" in the line.
+        for (int i = begin; i + 3 <= end; ++i) {
+            if (data[i] != '/' || data[i + 1] != '/' || data[i + 2] != '!')
+                continue;
+
+            int pos = i + 3;
+            while (pos < end && isMarkerSpace(data[pos]))
+                ++pos;
+            if (pos >= end || data[pos] != '[')
+                continue;
+
+            int idBegin = ++pos;
+            bool strippable = true;
+            while (pos < end && data[pos] != ']') {
+                strippable = strippable && isMarkerIdentifierChar(data[pos]);
+                ++pos;
+            }
+            if (pos >= end || pos == idBegin)
+                continue;
+
+            QByteArray id(data + idBegin, pos - idBegin);
+            QHash<QByteArray, File::Range>::iterator marker = f->markers.find(id);
+            if (marker == f->markers.end())
+                f->markers.insert(id, File::Range(lineNumber, -1));
+            else if (marker.value().second == -1 && marker.value().first != lineNumber)
+                marker.value().second = lineNumber;
+
+            if (strippable) {
+                f->strippedMarkers[lineNumber] << File::Range(i, pos + 1 - i);
+                i = pos;
+            }
+        }
+
+        begin = end;
+        ++lineNumber;
+    }
+    f->lineStarts << f->size;
+}
+
+QString CodeSnippetIndex::extractSnippet(const File* f, const QByteArray& identifier)
+{
+    const File::Range marker = f->markers.value(identifier);
+    int firstLine = marker.first + 1;
+    int lastLine = marker.second == -1 ? f->lineStarts.size() - 1 : marker.second;
+    if (firstLine >= lastLine)
+        return QString();
+
+    QString code;
+    code.reserve(f->lineStarts[lastLine] - f->lineStarts[firstLine]);
+
+    // Consecutive lines without markers are converted in one go.
+    int chunkBegin = f->lineStarts[firstLine];
+    for (int line = firstLine; line < lastLine; ++line) {
+        QHash<int, QList<File::Range> >::const_iterator stripped = f->strippedMarkers.find(line);
+        if (stripped == f->strippedMarkers.constEnd())
+            continue;
+
+        int lineBegin = f->lineStarts[line];
+        code += QString::fromAscii(f->data + chunkBegin, lineBegin - chunkBegin);
+        int pos = lineBegin;
+        foreach (const File::Range& range, stripped.value()) {
+            code += QString::fromAscii(f->data + pos, range.first - pos);
+            pos = range.first + range.second;
+        }
+        chunkBegin = f->lineStarts[line + 1];
+        code += QString::fromAscii(f->data + pos, chunkBegin - pos);
+    }
+    code += QString::fromAscii(f->data + chunkBegin, f->lineStarts[lastLine] - chunkBegin);
+    return code;
+}
@@ -0,0 +1,98 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef CODESNIPPETINDEX_H
+#define CODESNIPPETINDEX_H
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QPair>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include "generator.h"
+
+/**
+*   Keeps the code snippet files used by the documentation mapped in memory.
+*   Each file is read once, and a single pass records the lines of all its
+*   "//! [identifier]" markers, so later lookups only copy the lines of the
+*   requested block. Lookups may be done from several threads.
+*/
+class GENRUNNER_API CodeSnippetIndex
+{
+public:
+    enum Result {
+        FileNotFound,
+        SnippetNotFound,
+        SnippetFound
+    };
+
+    CodeSnippetIndex();
+    ~CodeSnippetIndex();
+
+    /**
+    *   Stores in code the lines between the first two "//! [identifier]" markers
+    *   of fileName, with the markers of other snippets removed. If the marker
+    *   appears only once the snippet goes until the end of the file, an empty
+    *   identifier selects the whole file.
+    */
+    Result snippet(const QString& fileName, const QString& identifier, QString* code);
+
+    /// Directories searched by findFile(), in order.
+    void setSearchDirectories(const QStringList& directories);
+
+    /**
+    *   Returns the path of relativePath in the first search directory that has it,
+    *   or an empty string. Each directory is listed once and both found and missing
+    *   files are remembered, so repeated lookups don't touch the file system.
+    */
+    QString findFile(const QString& relativePath);
+
+    /// Number of file lookups in search directories that findFile() answered from its caches.
+    int avoidedProbes() const;
+
+    /// Unmaps all the files and forgets the contents of the search directories.
+    void clear();
+
+private:
+    struct File;
+
+    File* file(const QString& fileName);
+    static void indexFile(File* file);
+    static QString extractSnippet(const File* file, const QByteArray& identifier);
+
+    const QSet<QString>& directoryEntries(const QString& directory);
+
+    // The path found and the number of directories tried to find it.
+    typedef QPair<QString, int> ResolvedPath;
+
+    QHash<QString, File*> m_files;
+    int m_mappedFiles;
+    QStringList m_searchDirectories;
+    QHash<QString, ResolvedPath> m_resolvedPaths;
+    QHash<QString, QSet<QString> > m_directoryEntries;
+    int m_avoidedProbes;
+    mutable QMutex m_mutex;
+};
+
+#endif // CODESNIPPETINDEX_H
@@ -0,0 +1,123 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "conversioncache.h"
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QFile>
+
+static const quint32 CACHE_MAGIC = 0x47524400; // "GRD\0"
+static const quint32 CACHE_VERSION = 1;
+
+ConversionCache::ConversionCache() : m_hits(0), m_misses(0)
+{
+}
+
+void ConversionCache::load(const QString& fileName, const QByteArray& salt)
+{
+    QMutexLocker locker(&m_mutex);
+    m_fileName = fileName;
+    m_salt = salt;
+    m_previous.clear();
+    m_current.clear();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_5);
+    quint32 magic;
+    quint32 version;
+    QByteArray savedSalt;
+    in >> magic >> version >> savedSalt;
+    if (magic != CACHE_MAGIC || version != CACHE_VERSION || savedSalt != salt)
+        return;
+
+    in >> m_previous;
+    if (in.status() != QDataStream::Ok)
+        m_previous.clear();
+}
+
+bool ConversionCache::save() const
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_fileName.isEmpty())
+        return false;
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << CACHE_MAGIC << CACHE_VERSION << m_salt << m_current;
+    return out.status() == QDataStream::Ok;
+}
+
+QByteArray ConversionCache::key(const QString& doc, const QString& context, int indent)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(context.toUtf8());
+    hash.addData("", 1);
+    hash.addData(QByteArray::number(indent));
+    hash.addData("", 1);
+    hash.addData(doc.toUtf8());
+    return hash.result();
+}
+
+bool ConversionCache::find(const QByteArray& key, QString* result)
+{
+    QMutexLocker locker(&m_mutex);
+    ConversionHash::const_iterator it = m_current.find(key);
+    if (it == m_current.constEnd()) {
+        it = m_previous.find(key);
+        if (it == m_previous.constEnd()) {
+            ++m_misses;
+            return false;
+        }
+        // Only the conversions used by this run are saved again.
+        it = m_current.insert(key, it.value());
+    }
+    ++m_hits;
+    *result = it.value();
+    return true;
+}
+
+void ConversionCache::insert(const QByteArray& key, const QString& result)
+{
+    QMutexLocker locker(&m_mutex);
+    m_current.insert(key, result);
+}
+
+int ConversionCache::hits() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_hits;
+}
+
+int ConversionCache::misses() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_misses;
+}
@@ -0,0 +1,75 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef CONVERSIONCACHE_H
+#define CONVERSIONCACHE_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include "generator.h"
+
+/**
+*   Keeps the reST produced from each documentation XML between runs, addressed
+*   by the hash of the XML and of everything else the conversion depends on.
+*   A run only reuses the conversions saved by a run with the same salt, where
+*   the salt covers the state shared by all conversions, e.g. the options and
+*   the classes of the module. Lookups may be done from several threads.
+*/
+class GENRUNNER_API ConversionCache
+{
+public:
+    ConversionCache();
+
+    /// Reads the conversions saved in fileName, if they were made with the same salt.
+    void load(const QString& fileName, const QByteArray& salt);
+
+    /// Writes to the file given to load() the conversions used or added since then.
+    bool save() const;
+
+    /// Key of the conversion of doc in the given context, starting at an indentation level.
+    static QByteArray key(const QString& doc, const QString& context, int indent);
+
+    /// Stores in result the conversion with the given key, returns false if there is none.
+    bool find(const QByteArray& key, QString* result);
+
+    void insert(const QByteArray& key, const QString& result);
+
+    /// Number of successful and failed calls to find().
+    int hits() const;
+    int misses() const;
+
+private:
+    typedef QHash<QByteArray, QString> ConversionHash;
+
+    QString m_fileName;
+    QByteArray m_salt;
+    ConversionHash m_previous;
+    ConversionHash m_current;
+    int m_hits;
+    int m_misses;
+    mutable QMutex m_mutex;
+};
+
+#endif // CONVERSIONCACHE_H
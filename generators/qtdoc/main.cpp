@@ -22,9 +22,21 @@
  */
 
 #include <QtCore>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
 
 int main(int argc, char *argv[])
 {
+#ifdef Q_OS_UNIX
+    // Become generatorrunner instead of waiting for it in another process.
+    QVector<char*> execArgs;
+    execArgs << const_cast<char*>("generatorrunner") << const_cast<char*>("--generator-set=qtdoc");
+    for (int i = 1; i < argc; i++)
+        execArgs << argv[i];
+    execArgs << 0;
+    execvp(execArgs[0], execArgs.data());
+#endif
     QStringList args;
     args.append("--generator-set=qtdoc");
     for (int i = 1; i < argc; i++)
@@ -22,54 +22,82 @@
  */
 
 #include "qtdocgenerator.h"
+#include "codesnippetindex.h"
+#include "conversioncache.h"
+#include "profiler.h"
 #include <reporthandler.h>
 #include <qtdocparser.h>
 #include <typedatabase.h>
 #include <algorithm>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QRunnable>
 #include <QtCore/QStack>
 #include <QtCore/QTextStream>
 #include <QtCore/QXmlStreamReader>
 #include <QtCore/QFile>
 #include <QtCore/QDir>
+#include <QtCore/QThreadPool>
 #include <fileout.h>
 #include <limits>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
 
 EXPORT_GENERATOR_PLUGIN(new QtDocGenerator)
 
-static Indentor INDENT;
-
-static bool shouldSkip(const AbstractMetaFunction* func)
-{
-    bool skipable =  func->isConstructor()
-                     || func->isModifiedRemoved()
-                     || func->declaringClass() != func->ownerClass()
-                     || func->isCastOperator()
-                     || func->name() == "operator=";
-
-    // Search a const clone
-    if (!skipable && !func->isConstant()) {
-        const AbstractMetaArgumentList funcArgs = func->arguments();
-        foreach (AbstractMetaFunction* f, func->ownerClass()->functions()) {
-            if (f != func
-                && f->isConstant()
-                && f->name() == func->name()
-                && f->arguments().count() == funcArgs.count()) {
-                // Compare each argument
-                bool cloneFound = true;
-
-                const AbstractMetaArgumentList fargs = f->arguments();
-                for (int i = 0, max = funcArgs.count(); i < max; ++i) {
-                    if (funcArgs.at(i)->type()->typeEntry() != fargs.at(i)->type()->typeEntry()) {
-                        cloneFound = false;
-                        break;
-                    }
-                }
-                if (cloneFound)
-                    return true;
-            }
+// The name and the argument type entries, shared by a function and its const clone.
+static QByteArray overloadKey(const AbstractMetaFunction* func)
+{
+    QByteArray key = func->name().toUtf8();
+    foreach (const AbstractMetaArgument* arg, func->arguments()) {
+        const TypeEntry* typeEntry = arg->type()->typeEntry();
+        key += '\0';
+        key.append(reinterpret_cast<const char*>(&typeEntry), sizeof(typeEntry));
+    }
+    return key;
+}
+
+static QSet<QByteArray> constOverloadKeys(const AbstractMetaClass* metaClass)
+{
+    QSet<QByteArray> keys;
+    foreach (const AbstractMetaFunction* func, metaClass->functions()) {
+        if (func->isConstant())
+            keys.insert(overloadKey(func));
+    }
+    return keys;
+}
+
+/**
+*   Returns the functions of metaClass left out of its documentation: constructors,
+*   removed, inherited and cast functions, assignment operators and the non-const
+*   functions with a const clone. The const overloads of each class are indexed once,
+*   so the whole class is decided in linear time.
+*/
+static QSet<const AbstractMetaFunction*> skippedFunctions(const AbstractMetaClass* metaClass)
+{
+    QSet<const AbstractMetaFunction*> skipped;
+    QHash<const AbstractMetaClass*, QSet<QByteArray> > constOverloads;
+    foreach (const AbstractMetaFunction* func, metaClass->functions()) {
+        bool skipable =  func->isConstructor()
+                         || func->isModifiedRemoved()
+                         || func->declaringClass() != func->ownerClass()
+                         || func->isCastOperator()
+                         || func->name() == "operator=";
+
+        // Search a const clone
+        if (!skipable && !func->isConstant()) {
+            const AbstractMetaClass* ownerClass = func->ownerClass();
+            QHash<const AbstractMetaClass*, QSet<QByteArray> >::iterator it = constOverloads.find(ownerClass);
+            if (it == constOverloads.end())
+                it = constOverloads.insert(ownerClass, constOverloadKeys(ownerClass));
+            skipable = it.value().contains(overloadKey(func));
         }
+
+        if (skipable)
+            skipped.insert(func);
     }
-    return skipable;
+    return skipped;
 }
 
 static bool functionSort(const AbstractMetaFunction* func1, const AbstractMetaFunction* func2)
@@ -79,77 +107,189 @@ static bool functionSort(const AbstractMetaFunction* func1, const AbstractMetaFu
 
 static QString createRepeatedChar(int i, char c)
 {
-    QString out;
-    for (int j = 0; j < i; ++j)
-        out += c;
+    return QString(i, QLatin1Char(c));
+}
+
+// Backslashes the characters with a meaning in reST, the text is copied only if it has any.
+static QString escape(const QChar* data, int size)
+{
+    int specialChars = 0;
+    for (int i = 0; i < size; ++i) {
+        if (data[i] == '*' || data[i] == '_')
+            ++specialChars;
+    }
+    if (!specialChars)
+        return QString(data, size);
 
-    return out;
+    QString result;
+    result.reserve(size + specialChars);
+    for (int i = 0; i < size; ++i) {
+        if (data[i] == '*' || data[i] == '_')
+            result += '\\';
+        result += data[i];
+    }
+    return result;
 }
 
-static QString escape(QString& str)
+static QString escape(const QString& str)
 {
-    return str
-            .replace("*", "\\*")
-            .replace("_", "\\_");
+    return escape(str.constData(), str.size());
 }
 
 static QString escape(const QStringRef& strref)
 {
-    QString str = strref.toString();
-    return escape(str);
+    return escape(strref.constData(), strref.size());
+}
+
+// Sorted by tag name, tagId() does a binary search on it.
+const QtXmlToSphinx::TagHandlerEntry QtXmlToSphinx::tagHandlers[] = {
+    { "argument", &QtXmlToSphinx::handleArgumentTag },
+    { "badcode", &QtXmlToSphinx::handleCodeTag },
+    { "bold", &QtXmlToSphinx::handleBoldTag },
+    { "brief", &QtXmlToSphinx::handleParaTag },
+    { "code", &QtXmlToSphinx::handleCodeTag },
+    { "codeline", &QtXmlToSphinx::handleDotsTag },
+    { "definition", &QtXmlToSphinx::handleUselessTag },
+    { "description", &QtXmlToSphinx::handleUselessTag },
+    { "dots", &QtXmlToSphinx::handleDotsTag },
+    { "generatedlist", &QtXmlToSphinx::handleIgnoredTag },
+    { "header", &QtXmlToSphinx::handleRowTag },
+    { "heading", &QtXmlToSphinx::handleHeadingTag },
+    { "image", &QtXmlToSphinx::handleImageTag },
+    { "inlineimage", &QtXmlToSphinx::handleImageTag },
+    { "italic", &QtXmlToSphinx::handleItalicTag },
+    { "item", &QtXmlToSphinx::handleItemTag },
+    { "legalese", &QtXmlToSphinx::handleCodeTag },
+    { "link", &QtXmlToSphinx::handleLinkTag },
+    { "list", &QtXmlToSphinx::handleListTag },
+    { "para", &QtXmlToSphinx::handleParaTag },
+    { "printuntil", &QtXmlToSphinx::handleUselessTag },
+    { "quotefile", &QtXmlToSphinx::handleQuoteFileTag },
+    { "quotefromfile", &QtXmlToSphinx::handleIgnoredTag },
+    { "raw", &QtXmlToSphinx::handleRawTag },
+    { "relation", &QtXmlToSphinx::handleUselessTag },
+    { "row", &QtXmlToSphinx::handleRowTag },
+    { "section", &QtXmlToSphinx::handleAnchorTag },
+    { "see-also", &QtXmlToSphinx::handleSeeAlsoTag },
+    { "skipto", &QtXmlToSphinx::handleIgnoredTag },
+    { "snippet", &QtXmlToSphinx::handleSnippetTag },
+    { "superscript", &QtXmlToSphinx::handleSuperScriptTag },
+    { "table", &QtXmlToSphinx::handleTableTag },
+    { "tableofcontents", &QtXmlToSphinx::handleIgnoredTag },
+    { "target", &QtXmlToSphinx::handleIgnoredTag },
+    { "teletype", &QtXmlToSphinx::handleArgumentTag },
+    { "term", &QtXmlToSphinx::handleTermTag },
+    { "underline", &QtXmlToSphinx::handleItalicTag }
+};
+
+const int QtXmlToSphinx::tagCount = sizeof(tagHandlers) / sizeof(tagHandlers[0]);
+
+// The last counter is for unknown tags.
+QAtomicInt QtXmlToSphinx::tagHits[tagCount + 1];
+
+int QtXmlToSphinx::tagId(const QStringRef& tagName)
+{
+    int low = 0;
+    int high = tagCount - 1;
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        int cmp = tagName.compare(QLatin1String(tagHandlers[middle].tagName));
+        if (!cmp)
+            return middle;
+        if (cmp < 0)
+            high = middle - 1;
+        else
+            low = middle + 1;
+    }
+    return UnknownTag;
+}
+
+QMap<QString, int> QtXmlToSphinx::tagHitCounts()
+{
+    QMap<QString, int> counts;
+    for (int i = 0; i < tagCount; ++i)
+        counts.insert(tagHandlers[i].tagName, tagHits[i]);
+    counts.insert("<unknown>", tagHits[tagCount]);
+    return counts;
+}
+
+QtXmlToSphinx::QtXmlToSphinx(QtDocGenerator* generator)
+        : m_generator(generator), m_insideBold(false), m_insideItalic(false), m_lastTag(UnknownTag),
+          m_cacheable(true), m_indentor(m_ownIndentor), m_headingType('-')
+{
+}
+
+QtXmlToSphinx::QtXmlToSphinx(QtDocGenerator* generator, Indentor& indentor)
+        : m_generator(generator), m_insideBold(false), m_insideItalic(false), m_lastTag(UnknownTag),
+          m_cacheable(true), m_indentor(indentor), m_headingType('-')
+{
 }
 
 QtXmlToSphinx::QtXmlToSphinx(QtDocGenerator* generator, const QString& doc, const QString& context)
-        : m_context(context), m_generator(generator), m_insideBold(false), m_insideItalic(false)
-{
-    m_handlerMap.insert("heading", &QtXmlToSphinx::handleHeadingTag);
-    m_handlerMap.insert("brief", &QtXmlToSphinx::handleParaTag);
-    m_handlerMap.insert("para", &QtXmlToSphinx::handleParaTag);
-    m_handlerMap.insert("italic", &QtXmlToSphinx::handleItalicTag);
-    m_handlerMap.insert("bold", &QtXmlToSphinx::handleBoldTag);
-    m_handlerMap.insert("see-also", &QtXmlToSphinx::handleSeeAlsoTag);
-    m_handlerMap.insert("snippet", &QtXmlToSphinx::handleSnippetTag);
-    m_handlerMap.insert("dots", &QtXmlToSphinx::handleDotsTag);
-    m_handlerMap.insert("codeline", &QtXmlToSphinx::handleDotsTag);
-    m_handlerMap.insert("table", &QtXmlToSphinx::handleTableTag);
-    m_handlerMap.insert("header", &QtXmlToSphinx::handleRowTag);
-    m_handlerMap.insert("row", &QtXmlToSphinx::handleRowTag);
-    m_handlerMap.insert("item", &QtXmlToSphinx::handleItemTag);
-    m_handlerMap.insert("argument", &QtXmlToSphinx::handleArgumentTag);
-    m_handlerMap.insert("teletype", &QtXmlToSphinx::handleArgumentTag);
-    m_handlerMap.insert("link", &QtXmlToSphinx::handleLinkTag);
-    m_handlerMap.insert("inlineimage", &QtXmlToSphinx::handleImageTag);
-    m_handlerMap.insert("image", &QtXmlToSphinx::handleImageTag);
-    m_handlerMap.insert("list", &QtXmlToSphinx::handleListTag);
-    m_handlerMap.insert("term", &QtXmlToSphinx::handleTermTag);
-    m_handlerMap.insert("raw", &QtXmlToSphinx::handleRawTag);
-    m_handlerMap.insert("underline", &QtXmlToSphinx::handleItalicTag);
-    m_handlerMap.insert("superscript", &QtXmlToSphinx::handleSuperScriptTag);
-    m_handlerMap.insert("code", &QtXmlToSphinx::handleCodeTag);
-    m_handlerMap.insert("badcode", &QtXmlToSphinx::handleCodeTag);
-    m_handlerMap.insert("legalese", &QtXmlToSphinx::handleCodeTag);
-    m_handlerMap.insert("section", &QtXmlToSphinx::handleAnchorTag);
-    m_handlerMap.insert("quotefile", &QtXmlToSphinx::handleQuoteFileTag);
-
-    // ignored tags
-    m_handlerMap.insert("generatedlist", &QtXmlToSphinx::handleIgnoredTag);
-    m_handlerMap.insert("tableofcontents", &QtXmlToSphinx::handleIgnoredTag);
-    m_handlerMap.insert("quotefromfile", &QtXmlToSphinx::handleIgnoredTag);
-    m_handlerMap.insert("skipto", &QtXmlToSphinx::handleIgnoredTag);
-    m_handlerMap.insert("target", &QtXmlToSphinx::handleIgnoredTag);
-
-    // useless tags
-    m_handlerMap.insert("description", &QtXmlToSphinx::handleUselessTag);
-    m_handlerMap.insert("definition", &QtXmlToSphinx::handleUselessTag);
-    m_handlerMap.insert("printuntil", &QtXmlToSphinx::handleUselessTag);
-    m_handlerMap.insert("relation", &QtXmlToSphinx::handleUselessTag);
+        : m_generator(generator), m_insideBold(false), m_insideItalic(false), m_lastTag(UnknownTag),
+          m_cacheable(true), m_indentor(m_ownIndentor), m_headingType('-')
+{
+    convert(doc, context);
+}
+
+bool QtXmlToSphinx::lastTagWasCode() const
+{
+    // "snippet", "dots" and "codeline".
+    return m_lastTag != UnknownTag
+           && (tagHandlers[m_lastTag].handler == &QtXmlToSphinx::handleSnippetTag
+               || tagHandlers[m_lastTag].handler == &QtXmlToSphinx::handleDotsTag);
+}
 
+QString QtXmlToSphinx::convert(const QString& doc, const QString& context)
+{
+    ConversionCache* cache = m_generator->conversionCache();
+    QByteArray cacheKey;
+    if (cache) {
+        cacheKey = ConversionCache::key(doc, context, m_indentor.indent);
+        if (cache->find(cacheKey, &m_result))
+            return m_result;
+    }
+
+    // Forget whatever the previous document left behind, e.g. after an XML error.
+    m_output.setString(0);
+    qDeleteAll(m_buffers);
+    m_buffers.clear();
+    m_handlers.clear();
+    m_currentTable.clear();
+    m_tableHasHeader = false;
+    m_context = context;
+    m_insideBold = false;
+    m_insideItalic = false;
+    m_lastTag = UnknownTag;
+    m_opened_anchor.clear();
+    m_heading.clear();
+    m_headingType = '-';
+    m_listType.clear();
+    m_linkTag.clear();
+    m_linkRef.clear();
+    m_linkText.clear();
+    m_linkTagEnding.clear();
+    m_linkType.clear();
+    m_cacheable = true;
+
+    // Handlers that change the indentation may not see the end of their tags.
+    int indent = m_indentor.indent;
     m_result = transform(doc);
+    m_indentor.indent = indent;
+
+    if (cache && m_cacheable)
+        cache->insert(cacheKey, m_result);
+    return m_result;
+}
+
+QtXmlToSphinx::~QtXmlToSphinx()
+{
+    qDeleteAll(m_buffers);
 }
 
 void QtXmlToSphinx::pushOutputBuffer()
 {
-    QString* buffer = new QString();
+    QString* buffer = new QString;
     m_buffers << buffer;
     m_output.setString(buffer);
 }
@@ -157,24 +297,19 @@ void QtXmlToSphinx::pushOutputBuffer()
 QString QtXmlToSphinx::popOutputBuffer()
 {
     Q_ASSERT(!m_buffers.isEmpty());
-    QString* str = m_buffers.pop();
-    QString strcpy(*str);
-    delete str;
+    QString* buffer = m_buffers.pop();
     m_output.setString(m_buffers.isEmpty() ? 0 : m_buffers.top());
-    return strcpy;
+    // The result shares the text of the buffer, no copy is made.
+    QString result(*buffer);
+    delete buffer;
+    return result;
 }
 
 QString QtXmlToSphinx::resolveContextForMethod(const QString& methodName)
 {
     QString currentClass = m_context.split(".").last();
 
-    const AbstractMetaClass* metaClass = 0;
-    foreach (const AbstractMetaClass* cls, m_generator->classes()) {
-        if (cls->name() == currentClass) {
-            metaClass = cls;
-            break;
-        }
-    }
+    const AbstractMetaClass* metaClass = m_generator->findAbstractMetaClassByName(currentClass);
 
     if (metaClass) {
         QList<const AbstractMetaFunction*> funcList;
@@ -200,7 +335,7 @@ QString QtXmlToSphinx::resolveContextForMethod(const QString& methodName)
 QString QtXmlToSphinx::transform(const QString& doc)
 {
     Q_ASSERT(m_buffers.isEmpty());
-    Indentation indentation(INDENT);
+    Indentation indentation(m_indentor);
     if (doc.trimmed().isEmpty())
         return doc;
 
@@ -211,14 +346,17 @@ QString QtXmlToSphinx::transform(const QString& doc)
     while (!reader.atEnd()) {
         QXmlStreamReader::TokenType token = reader.readNext();
         if (reader.hasError()) {
-            m_output << INDENT << "XML Error: " + reader.errorString() + "\n" + doc;
+            m_cacheable = false;
+            m_output << m_indentor << "XML Error: " + reader.errorString() + "\n" + doc;
+            QMutexLocker locker(&reportHandlerMutex());
             ReportHandler::warning("XML Error: " + reader.errorString() + "\n" + doc);
             break;
         }
 
         if (token == QXmlStreamReader::StartElement) {
-            QStringRef tagName = reader.name();
-            TagHandler handler = m_handlerMap.value(tagName.toString(), &QtXmlToSphinx::handleUnknownTag);
+            int tag = tagId(reader.name());
+            tagHits[tag == UnknownTag ? tagCount : tag].ref();
+            TagHandler handler = tag == UnknownTag ? &QtXmlToSphinx::handleUnknownTag : tagHandlers[tag].handler;
             if (!m_handlers.isEmpty() && ( (m_handlers.top() == &QtXmlToSphinx::handleIgnoredTag) ||
                                            (m_handlers.top() == &QtXmlToSphinx::handleRawTag)) )
                 handler = &QtXmlToSphinx::handleIgnoredTag;
@@ -230,7 +368,7 @@ QString QtXmlToSphinx::transform(const QString& doc)
 
         if (token == QXmlStreamReader::EndElement) {
             m_handlers.pop();
-            m_lastTagName = reader.name().toString();
+            m_lastTag = tagId(reader.name());
         }
     }
     m_output.flush();
@@ -239,57 +377,45 @@ QString QtXmlToSphinx::transform(const QString& doc)
     return retval;
 }
 
-QString QtXmlToSphinx::readFromLocations(const QStringList& locations, const QString& path, const QString& identifier)
+QString QtXmlToSphinx::readFromLocations(const QString& path, const QString& identifier)
 {
-    QString result;
+    // The files may change while the documentation doesn't.
+    m_cacheable = false;
+    QString location = m_generator->codeSnippetIndex()->findFile(path);
+    if (location.isEmpty()) {
+        QMutexLocker locker(&reportHandlerMutex());
+        ReportHandler::warning("Couldn't read code snippet file: {"+ m_generator->codeSnippetDirs().join("|") + '}' + path);
+        return QString();
+    }
+
     bool ok;
-    foreach (QString location, locations) {
-        location.append('/');
-        location.append(path);
-        result = readFromLocation(location, identifier, &ok);
-        if (ok)
-            break;
+    QString result = readFromLocation(location, identifier, &ok);
+    if (!ok) {
+        QMutexLocker locker(&reportHandlerMutex());
+        ReportHandler::warning("Couldn't read code snippet file: " + location);
     }
-    if (!ok)
-        ReportHandler::warning("Couldn't read code snippet file: {"+ locations.join("|") + '}' + path);
     return result;
 }
 
 QString QtXmlToSphinx::readFromLocation(const QString& location, const QString& identifier, bool* ok)
 {
-    QFile inputFile;
-    inputFile.setFileName(location);
-    if (!inputFile.open(QIODevice::ReadOnly)) {
-        if (!ok)
-            ReportHandler::warning("Couldn't read code snippet file: "+inputFile.fileName());
-        else
-            *ok = false;
-        return QString();
-    }
-
-    QRegExp searchString("//!\\s*\\[" + identifier + "\\]");
-    QRegExp codeSnippetCode("//!\\s*\\[[\\w\\d\\s]+\\]");
+    m_cacheable = false;
     QString code;
-    QString line;
-    bool identifierIsEmpty = identifier.isEmpty();
-    bool getCode = false;
-
-    while (!inputFile.atEnd()) {
-        line = inputFile.readLine();
-        if (identifierIsEmpty) {
-            code += line;
-        } else if (getCode && !line.contains(searchString)) {
-            code += line.replace(codeSnippetCode, "");
-        } else if (line.contains(searchString)) {
-            if (getCode)
-                break;
-            else
-                getCode = true;
+    CodeSnippetIndex::Result result = m_generator->codeSnippetIndex()->snippet(location, identifier, &code);
+    if (result == CodeSnippetIndex::FileNotFound) {
+        if (!ok) {
+            QMutexLocker locker(&reportHandlerMutex());
+            ReportHandler::warning("Couldn't read code snippet file: "+location);
+        } else {
+            *ok = false;
         }
+        return QString();
     }
 
-    if (!identifierIsEmpty && !getCode)
+    if (result == CodeSnippetIndex::SnippetNotFound) {
+        QMutexLocker locker(&reportHandlerMutex());
         ReportHandler::warning("Code snippet file found ("+location+"), but snippet "+ identifier +" not found.");
+    }
 
     if (ok)
         *ok = true;
@@ -298,21 +424,19 @@ QString QtXmlToSphinx::readFromLocation(const QString& location, const QString&
 
 void QtXmlToSphinx::handleHeadingTag(QXmlStreamReader& reader)
 {
-    static QString heading;
-    static char type;
-    static char types[] = { '-', '^' };
+    static const char types[] = { '-', '^' };
     QXmlStreamReader::TokenType token = reader.tokenType();
     if (token == QXmlStreamReader::StartElement) {
         uint typeIdx = reader.attributes().value("level").toString().toInt();
         if (typeIdx >= sizeof(types))
-            type = types[sizeof(types)-1];
+            m_headingType = types[sizeof(types)-1];
         else
-            type = types[typeIdx];
+            m_headingType = types[typeIdx];
     } else if (token == QXmlStreamReader::EndElement) {
-        m_output << createRepeatedChar(heading.length(), type) << endl << endl;
+        m_output << createRepeatedChar(m_heading.length(), m_headingType) << endl << endl;
     } else if (token == QXmlStreamReader::Characters) {
-        heading = escape(reader.text()).trimmed();
-        m_output << endl << endl << heading << endl;
+        m_heading = escape(reader.text()).trimmed();
+        m_output << endl << endl << m_heading << endl;
     }
 }
 
@@ -328,7 +452,7 @@ void QtXmlToSphinx::handleParaTag(QXmlStreamReader& reader)
         else if (result.startsWith("**Note:**"))
             result.replace(0, 9, ".. note:: ");
 
-        m_output << INDENT << result << endl << endl;
+        m_output << m_indentor << result << endl << endl;
     } else if (token == QXmlStreamReader::Characters) {
         QString text = escape(reader.text());
         if (!m_output.string()->isEmpty()) {
@@ -337,7 +461,7 @@ void QtXmlToSphinx::handleParaTag(QXmlStreamReader& reader)
             if ((end == '*' || end == '`') && start != ' ' && !start.isPunct())
                 m_output << '\\';
         }
-        m_output << INDENT << text;
+        m_output << m_indentor << text;
     }
 }
 
@@ -376,7 +500,7 @@ void QtXmlToSphinx::handleSeeAlsoTag(QXmlStreamReader& reader)
 {
     QXmlStreamReader::TokenType token = reader.tokenType();
     if (token == QXmlStreamReader::StartElement)
-        m_output << INDENT << ".. seealso:: ";
+        m_output << m_indentor << ".. seealso:: ";
     else if (token == QXmlStreamReader::EndElement)
         m_output << endl;
 }
@@ -385,24 +509,24 @@ void QtXmlToSphinx::handleSnippetTag(QXmlStreamReader& reader)
 {
     QXmlStreamReader::TokenType token = reader.tokenType();
     if (token == QXmlStreamReader::StartElement) {
-        bool consecutiveSnippet = m_lastTagName == "snippet" || m_lastTagName == "dots" || m_lastTagName == "codeline";
+        bool consecutiveSnippet = lastTagWasCode();
         if (consecutiveSnippet) {
             m_output.flush();
             m_output.string()->chop(2);
         }
         QString location = reader.attributes().value("location").toString();
         QString identifier = reader.attributes().value("identifier").toString();
-        QString code = readFromLocations(m_generator->codeSnippetDirs(), location, identifier);
+        QString code = readFromLocations(location, identifier);
         if (!consecutiveSnippet)
-            m_output << INDENT << "::\n\n";
+            m_output << m_indentor << "::\n\n";
 
-        Indentation indentation(INDENT);
+        Indentation indentation(m_indentor);
         if (code.isEmpty()) {
-            m_output << INDENT << "<Code snippet \"" << location << ':' << identifier << "\" not found>" << endl;
+            m_output << m_indentor << "<Code snippet \"" << location << ':' << identifier << "\" not found>" << endl;
         } else {
             foreach (QString line, code.split("\n")) {
                 if (!QString(line).trimmed().isEmpty())
-                    m_output << INDENT << line;
+                    m_output << m_indentor << line;
 
                 m_output << endl;
             }
@@ -414,14 +538,14 @@ void QtXmlToSphinx::handleDotsTag(QXmlStreamReader& reader)
 {
     QXmlStreamReader::TokenType token = reader.tokenType();
     if (token == QXmlStreamReader::StartElement) {
-        bool consecutiveSnippet = m_lastTagName == "snippet" || m_lastTagName == "dots" || m_lastTagName == "codeline";
+        bool consecutiveSnippet = lastTagWasCode();
         if (consecutiveSnippet) {
             m_output.flush();
             m_output.string()->chop(2);
         }
-        Indentation indentation(INDENT);
+        Indentation indentation(m_indentor);
         pushOutputBuffer();
-        m_output << INDENT;
+        m_output << m_indentor;
         int indent = reader.attributes().value("indent").toString().toInt();
         for (int i = 0; i < indent; ++i)
             m_output << ' ';
@@ -440,9 +564,7 @@ void QtXmlToSphinx::handleTableTag(QXmlStreamReader& reader)
         m_tableHasHeader = false;
     } else if (token == QXmlStreamReader::EndElement) {
         // write the table on m_output
-        m_currentTable.enableHeader(m_tableHasHeader);
-        m_currentTable.normalize();
-        m_output << m_currentTable;
+        writeTable(m_currentTable);
         m_currentTable.clear();
     }
 }
@@ -496,31 +618,28 @@ void QtXmlToSphinx::handleRowTag(QXmlStreamReader& reader)
 void QtXmlToSphinx::handleListTag(QXmlStreamReader& reader)
 {
     // BUG We do not support a list inside a table cell
-    static QString listType;
     QXmlStreamReader::TokenType token = reader.tokenType();
     if (token == QXmlStreamReader::StartElement) {
-        listType = reader.attributes().value("type").toString();
-        if (listType == "enum") {
+        m_listType = reader.attributes().value("type").toString();
+        if (m_listType == "enum") {
             m_currentTable << (TableRow() << "Constant" << "Description");
             m_tableHasHeader = true;
         }
-        INDENT.indent--;
+        m_indentor.indent--;
     } else if (token == QXmlStreamReader::EndElement) {
-        INDENT.indent++;
+        m_indentor.indent++;
         if (!m_currentTable.isEmpty()) {
-            if (listType == "bullet") {
+            if (m_listType == "bullet") {
                 m_output << endl;
                 foreach (TableCell cell, m_currentTable.first()) {
                     QStringList itemLines = cell.data.split('\n');
-                    m_output << INDENT << "* " << itemLines.first() << endl;
+                    m_output << m_indentor << "* " << itemLines.first() << endl;
                     for (int i = 1, max = itemLines.count(); i < max; ++i)
-                        m_output << INDENT << "  " << itemLines[i] << endl;
+                        m_output << m_indentor << "  " << itemLines[i] << endl;
                 }
                 m_output << endl;
-            } else if (listType == "enum") {
-                m_currentTable.enableHeader(m_tableHasHeader);
-                m_currentTable.normalize();
-                m_output << m_currentTable;
+            } else if (m_listType == "enum") {
+                writeTable(m_currentTable);
             }
         }
         m_currentTable.clear();
@@ -529,92 +648,87 @@ void QtXmlToSphinx::handleListTag(QXmlStreamReader& reader)
 
 void QtXmlToSphinx::handleLinkTag(QXmlStreamReader& reader)
 {
-    static QString l_linktag;
-    static QString l_linkref;
-    static QString l_linktext;
-    static QString l_linktagending;
-    static QString l_type;
     QXmlStreamReader::TokenType token = reader.tokenType();
     if (token == QXmlStreamReader::StartElement) {
-        l_linktagending = "` ";
+        m_linkTagEnding = "` ";
         if (m_insideBold) {
-            l_linktag.prepend("**");
-            l_linktagending.append("**");
+            m_linkTag.prepend("**");
+            m_linkTagEnding.append("**");
         } else if (m_insideItalic) {
-            l_linktag.prepend('*');
-            l_linktagending.append('*');
+            m_linkTag.prepend('*');
+            m_linkTagEnding.append('*');
         }
-        l_type = reader.attributes().value("type").toString();
+        m_linkType = reader.attributes().value("type").toString();
 
         // TODO: create a flag PROPERTY-AS-FUNCTION to ask if the properties
         // are recognized as such or not in the binding
-        if (l_type == "property")
-            l_type = "function";
+        if (m_linkType == "property")
+            m_linkType = "function";
 
-        if (l_type == "typedef")
-            l_type = "class";
+        if (m_linkType == "typedef")
+            m_linkType = "class";
 
         QString linkSource;
-        if (l_type == "function" || l_type == "class") {
+        if (m_linkType == "function" || m_linkType == "class") {
             linkSource  = "raw";
-        } else if (l_type == "enum") {
+        } else if (m_linkType == "enum") {
             linkSource  = "enum";
-        } else if (l_type == "page") {
+        } else if (m_linkType == "page") {
             linkSource  = "page";
         } else {
             linkSource = "href";
         }
 
-        l_linkref = reader.attributes().value(linkSource).toString();
-        l_linkref.replace("::", ".");
-        l_linkref.remove("()");
+        m_linkRef = reader.attributes().value(linkSource).toString();
+        m_linkRef.replace("::", ".");
+        m_linkRef.remove("()");
 
-        if (l_type == "function" && !m_context.isEmpty()) {
-            l_linktag = " :meth:`";
-            QStringList rawlinklist = l_linkref.split(".");
+        if (m_linkType == "function" && !m_context.isEmpty()) {
+            m_linkTag = " :meth:`";
+            QStringList rawlinklist = m_linkRef.split(".");
             if (rawlinklist.size() == 1 || rawlinklist.first() == m_context) {
                 QString context = resolveContextForMethod(rawlinklist.last());
-                if (!l_linkref.startsWith(context))
-                    l_linkref.prepend(context + '.');
+                if (!m_linkRef.startsWith(context))
+                    m_linkRef.prepend(context + '.');
             }
-        } else if (l_type == "function" && m_context.isEmpty()) {
-            l_linktag = " :func:`";
-        } else if (l_type == "class") {
-            l_linktag = " :class:`";
-            TypeEntry* type = TypeDatabase::instance()->findType(l_linkref);
+        } else if (m_linkType == "function" && m_context.isEmpty()) {
+            m_linkTag = " :func:`";
+        } else if (m_linkType == "class") {
+            m_linkTag = " :class:`";
+            TypeEntry* type = TypeDatabase::instance()->findType(m_linkRef);
             if (type) {
-                l_linkref = type->qualifiedTargetLangName();
+                m_linkRef = type->qualifiedTargetLangName();
             } else { // fall back to the old heuristic if the type wasn't found.
-                QStringList rawlinklist = l_linkref.split(".");
+                QStringList rawlinklist = m_linkRef.split(".");
                 QStringList splittedContext = m_context.split(".");
                 if (rawlinklist.size() == 1 || rawlinklist.first() == splittedContext.last()) {
                     splittedContext.removeLast();
-                    l_linkref.prepend('~' + splittedContext.join(".") + '.');
+                    m_linkRef.prepend('~' + splittedContext.join(".") + '.');
                 }
             }
-        } else if (l_type == "enum") {
-            l_linktag = " :attr:`";
-        } else if (l_type == "page" && l_linkref == m_generator->moduleName()) {
-            l_linktag = " :mod:`";
+        } else if (m_linkType == "enum") {
+            m_linkTag = " :attr:`";
+        } else if (m_linkType == "page" && m_linkRef == m_generator->moduleName()) {
+            m_linkTag = " :mod:`";
         } else {
-            l_linktag = " :ref:`";
+            m_linkTag = " :ref:`";
         }
 
     } else if (token == QXmlStreamReader::Characters) {
         QString linktext = reader.text().toString();
         linktext.replace("::", ".");
-        QString item = l_linkref.split(".").last();
-        if (l_linkref == linktext
-            || (l_linkref + "()") == linktext
+        QString item = m_linkRef.split(".").last();
+        if (m_linkRef == linktext
+            || (m_linkRef + "()") == linktext
             || item == linktext
             || (item + "()") == linktext)
-            l_linktext.clear();
+            m_linkText.clear();
         else
-            l_linktext = linktext + QLatin1String("<");
+            m_linkText = linktext + QLatin1String("<");
     } else if (token == QXmlStreamReader::EndElement) {
-        if (!l_linktext.isEmpty())
-            l_linktagending.prepend('>');
-        m_output << l_linktag << l_linktext << escape(l_linkref) << l_linktagending;
+        if (!m_linkText.isEmpty())
+            m_linkTagEnding.prepend('>');
+        m_output << m_linkTag << m_linkText << escape(m_linkRef) << m_linkTagEnding;
     }
 }
 
@@ -627,7 +741,7 @@ void QtXmlToSphinx::handleImageTag(QXmlStreamReader& reader)
         QString imgPath = dir.relativeFilePath(m_generator->libSourceDir() + "/doc/src/") + '/' + href;
 
         if (reader.name() == "image")
-            m_output << INDENT << ".. image:: " <<  imgPath << endl << endl;
+            m_output << m_indentor << ".. image:: " <<  imgPath << endl << endl;
         else
             m_output << ".. image:: " << imgPath << ' ';
     }
@@ -638,11 +752,11 @@ void QtXmlToSphinx::handleRawTag(QXmlStreamReader& reader)
     QXmlStreamReader::TokenType token = reader.tokenType();
     if (token == QXmlStreamReader::StartElement) {
         QString format = reader.attributes().value("format").toString();
-        m_output << INDENT << ".. raw:: " << format.toLower() << endl << endl;
+        m_output << m_indentor << ".. raw:: " << format.toLower() << endl << endl;
     } else if (token == QXmlStreamReader::Characters) {
         QStringList lst(reader.text().toString().split("\n"));
         foreach(QString row, lst)
-            m_output << INDENT << INDENT << row << endl;
+            m_output << m_indentor << m_indentor << row << endl;
     } else if (token == QXmlStreamReader::EndElement) {
         m_output << endl << endl;
     }
@@ -653,23 +767,26 @@ void QtXmlToSphinx::handleCodeTag(QXmlStreamReader& reader)
     QXmlStreamReader::TokenType token = reader.tokenType();
     if (token == QXmlStreamReader::StartElement) {
         QString format = reader.attributes().value("format").toString();
-        m_output << INDENT << "::" << endl << endl;
-        INDENT.indent++;
+        m_output << m_indentor << "::" << endl << endl;
+        m_indentor.indent++;
     } else if (token == QXmlStreamReader::Characters) {
         QStringList lst(reader.text().toString().split("\n"));
         foreach(QString row, lst)
-            m_output << INDENT << INDENT << row << endl;
+            m_output << m_indentor << m_indentor << row << endl;
     } else if (token == QXmlStreamReader::EndElement) {
         m_output << endl << endl;
-        INDENT.indent--;
+        m_indentor.indent--;
     }
 }
 
 void QtXmlToSphinx::handleUnknownTag(QXmlStreamReader& reader)
 {
     QXmlStreamReader::TokenType token = reader.tokenType();
-    if (token == QXmlStreamReader::StartElement)
+    if (token == QXmlStreamReader::StartElement) {
+        m_cacheable = false;
+        QMutexLocker locker(&reportHandlerMutex());
         ReportHandler::warning("Unknow QtDoc tag: \"" + reader.name().toString() + "\".");
+    }
 }
 
 void QtXmlToSphinx::handleSuperScriptTag(QXmlStreamReader& reader)
@@ -707,7 +824,7 @@ void QtXmlToSphinx::handleAnchorTag(QXmlStreamReader& reader)
             anchor = reader.attributes().value("name").toString();
         if (!anchor.isEmpty() && m_opened_anchor != anchor) {
             m_opened_anchor = anchor;
-            m_output << INDENT << ".. _" << m_context << "_" << anchor.toLower() << ":" << endl << endl;
+            m_output << m_indentor << ".. _" << m_context << "_" << anchor.toLower() << ":" << endl << endl;
         }
    } else if (token == QXmlStreamReader::EndElement) {
        m_opened_anchor = "";
@@ -723,14 +840,14 @@ void QtXmlToSphinx::handleQuoteFileTag(QXmlStreamReader& reader)
         location.prepend(m_generator->libSourceDir() + '/');
         QString code = readFromLocation(location, identifier);
 
-        m_output << INDENT << "::\n\n";
-        Indentation indentation(INDENT);
+        m_output << m_indentor << "::\n\n";
+        Indentation indentation(m_indentor);
         if (code.isEmpty()) {
-            m_output << INDENT << "<Code snippet \"" << location << "\" not found>" << endl;
+            m_output << m_indentor << "<Code snippet \"" << location << "\" not found>" << endl;
         } else {
             foreach (QString line, code.split("\n")) {
                 if (!QString(line).trimmed().isEmpty())
-                    m_output << INDENT << line;
+                    m_output << m_indentor << line;
 
                 m_output << endl;
             }
@@ -744,62 +861,121 @@ void QtXmlToSphinx::Table::normalize()
     if (m_normalized || isEmpty())
         return;
 
-    int row;
-    int col;
-    QtXmlToSphinx::Table& self = *this;
-
     //QDoc3 generates tables with wrong number of columns. We have to
     //check and if necessary, merge the last columns.
-    int maxCols = self.at(0).count();
-    // add col spans
-    for (row = 0; row < count(); ++row) {
-        for (col = 0; col < at(row).count(); ++col) {
-            QtXmlToSphinx::TableCell& cell = self[row][col];
-            bool mergeCols = (col >= maxCols);
-            if (cell.colSpan > 0) {
-                QtXmlToSphinx::TableCell newCell;
+    const int maxCols = first().count();
+    const int numRows = count();
+    int numCols = -1;
+
+    // For each column of the first row, the number of rows still covered by
+    // a row span and whether the next cell must be left as it is.
+    QVector<int> pendingRowSpans;
+    QVector<bool> skipRowSpan;
+    TableRow expanded;
+    expanded.reserve(maxCols * 2);
+
+    for (int row = 0; row < numRows; ++row) {
+        TableRow& cells = (*this)[row];
+
+        // add col spans, the cell right after a spanning cell is never checked.
+        expanded.resize(0);
+        bool skipColSpan = false;
+        for (int source = 0, col = 0; ; ++col) {
+            if (col == expanded.count()) {
+                if (source == cells.count())
+                    break;
+                expanded << cells[source++];
+            }
+            if (skipColSpan) {
+                skipColSpan = false;
+                continue;
+            }
+            if (expanded[col].colSpan > 0) {
+                TableCell newCell;
                 newCell.colSpan = -1;
-                for (int i = 0, max = cell.colSpan-1; i < max; ++i) {
-                    self[row].insert(col+1, newCell);
-                }
-                cell.colSpan = 0;
-                col++;
-            } else if (mergeCols) {
-                self[row][maxCols - 1].data += " " + cell.data;
+                int span = expanded[col].colSpan;
+                expanded[col].colSpan = 0;
+                for (int i = 0; i < span - 1; ++i)
+                    expanded << newCell;
+                skipColSpan = true;
+            } else if (col >= maxCols && maxCols > 0) {
+                expanded[maxCols - 1].data += " " + expanded[col].data;
             }
         }
-    }
 
-    // row spans
-    const int numCols = first().count();
-    for (col = 0; col < numCols; ++col) {
-        for (row = 0; row < count(); ++row) {
-            if (col < self[row].count()) {
-                QtXmlToSphinx::TableCell& cell = self[row][col];
-                if (cell.rowSpan > 0) {
-                    QtXmlToSphinx::TableCell newCell;
-                    newCell.rowSpan = -1;
-                    int max = std::min(cell.rowSpan - 1, count());
-                    cell.rowSpan = 0;
-                    for (int i = 0; i < max; ++i) {
-                        self[row+i+1].insert(col, newCell);
-                    }
-                    row++;
-                }
+        if (numCols < 0) {
+            numCols = expanded.count();
+            pendingRowSpans.fill(0, numCols);
+            skipRowSpan.fill(false, numCols);
+        }
+
+        // row spans, adding the cells covered by the spans of the rows above.
+        TableRow normalized;
+        normalized.reserve(expanded.count() + numCols);
+        int col = 0;
+        for (int source = 0; source < expanded.count() || (col < numCols && pendingRowSpans[col] > 0); ++col) {
+            if (col < numCols && pendingRowSpans[col] > 0) {
+                TableCell newCell;
+                newCell.rowSpan = -1;
+                normalized << newCell;
+                --pendingRowSpans[col];
+                skipRowSpan[col] = false;
+                continue;
             }
+
+            normalized << expanded[source++];
+            if (col >= numCols)
+                continue;
+
+            TableCell& cell = normalized.last();
+            if (skipRowSpan[col]) {
+                skipRowSpan[col] = false;
+            } else if (cell.rowSpan > 0) {
+                pendingRowSpans[col] = std::min(cell.rowSpan - 1, numRows - row - 1);
+                cell.rowSpan = 0;
+                skipRowSpan[col] = true;
+            }
+        }
+        // The columns this row is too short to reach still count it.
+        for (; col < numCols; ++col) {
+            if (pendingRowSpans[col] > 0)
+                --pendingRowSpans[col];
+            skipRowSpan[col] = false;
         }
+        cells = normalized;
     }
+
+    measureCells();
     m_normalized = true;
 }
 
-QTextStream& operator<<(QTextStream& s, const QtXmlToSphinx::Table &table)
+void QtXmlToSphinx::Table::measureCells()
+{
+    for (iterator row = begin(); row != end(); ++row) {
+        for (TableRow::iterator cell = row->begin(); cell != row->end(); ++cell) {
+            cell->lines = cell->data.split('\n');
+            cell->width = 0;
+            foreach (const QString& line, cell->lines)
+                cell->width = std::max(cell->width, line.count());
+        }
+    }
+}
+
+static inline void appendRepeatedChar(QString& out, int count, char c)
+{
+    for (int i = 0; i < count; ++i)
+        out += QLatin1Char(c);
+}
+
+static void writeTable(QTextStream& s, const QtXmlToSphinx::Table& table, const Indentor& indentor)
 {
     if (table.isEmpty())
-        return s;
+        return;
 
     if (!table.isNormalized()) {
+        QMutexLocker locker(&reportHandlerMutex());
         ReportHandler::warning("Attempt to print an unnormalized table!");
-        return s;
+        return;
     }
 
     // calc width and height of each column and row
@@ -808,111 +984,151 @@ QTextStream& operator<<(QTextStream& s, const QtXmlToSphinx::Table &table)
     for (int i = 0, maxI = table.count(); i < maxI; ++i) {
         const QtXmlToSphinx::TableRow& row = table[i];
         for (int j = 0, maxJ = std::min(row.count(), colWidths.size()); j < maxJ; ++j) {
-            QStringList rowLines = row[j].data.split('\n'); // cache this would be a good idea
-            foreach (QString str, rowLines)
-                colWidths[j] = std::max(colWidths[j], str.count());
-            rowHeights[i] = std::max(rowHeights[i], row[j].data.count('\n') + 1);
+            colWidths[j] = std::max(colWidths[j], row[j].width);
+            rowHeights[i] = std::max(rowHeights[i], row[j].lines.count());
         }
     }
 
     if (!*std::max_element(colWidths.begin(), colWidths.end()))
-        return s; // empty table (table with empty cells)
+        return; // empty table (table with empty cells)
+
+    QString indent(indentor.indent * 4, QLatin1Char(' '));
 
     // create a horizontal line to be used later.
+    int lineWidth = 1;
     QString horizontalLine("+");
     for (int i = 0, max = colWidths.count(); i < max; ++i) {
         horizontalLine += createRepeatedChar(colWidths[i], '-');
         horizontalLine += '+';
+        lineWidth += colWidths[i] + 1;
     }
 
+    // The whole table is written to a single buffer, allocated once.
+    int lineCount = table.count() + 1;
+    foreach (int height, rowHeights)
+        lineCount += height;
+    QString out;
+    out.reserve((indent.size() + lineWidth + 1) * lineCount + 1);
+
     // write table rows
+    const QString emptyLine;
     for (int i = 0, maxI = table.count(); i < maxI; ++i) { // for each row
         const QtXmlToSphinx::TableRow& row = table[i];
 
         // print line
-        s << INDENT << '+';
+        out += indent;
+        out += '+';
         for (int col = 0, max = colWidths.count(); col < max; ++col) {
             char c;
-            if (col >= row.length() || row[col].rowSpan == -1)
+            if (col >= row.count() || row[col].rowSpan == -1)
                 c = ' ';
             else if (i == 1 && table.hasHeader())
                 c = '=';
             else
                 c = '-';
-            s << createRepeatedChar(colWidths[col], c) << '+';
+            appendRepeatedChar(out, colWidths[col], c);
+            out += '+';
         }
-        s << endl;
-
+        out += '\n';
 
         // Print the table cells
         for (int rowLine = 0; rowLine < rowHeights[i]; ++rowLine) { // for each line in a row
             for (int j = 0, maxJ = std::min(row.count(), colWidths.size()); j < maxJ; ++j) { // for each column
                 const QtXmlToSphinx::TableCell& cell = row[j];
-                QStringList rowLines = cell.data.split('\n'); // FIXME: Cache this!!!
                 if (!j) // First column, so we need print the identation
-                    s << INDENT;
+                    out += indent;
 
                 if (!j || !cell.colSpan)
-                    s << '|';
+                    out += '|';
                 else
-                    s << ' ';
-                s << qSetFieldWidth(colWidths[j]) << left;
-                s << (rowLine < rowLines.count() ? rowLines[rowLine] : "");
-                s << qSetFieldWidth(0);
+                    out += ' ';
+                const QString& text = rowLine < cell.lines.count() ? cell.lines[rowLine] : emptyLine;
+                out += text;
+                appendRepeatedChar(out, colWidths[j] - text.size(), ' ');
             }
-            s << '|' << endl;
+            out += "|\n";
         }
     }
-    s << INDENT << horizontalLine << endl;
-    s << endl;
+    out += indent;
+    out += horizontalLine;
+    out += "\n\n";
+    s << out;
+}
+
+void QtXmlToSphinx::writeTable(Table& table)
+{
+    table.enableHeader(m_tableHasHeader);
+    table.normalize();
+    ::writeTable(m_output, table, m_indentor);
+}
+
+QTextStream& operator<<(QTextStream& s, const QtXmlToSphinx::Table &table)
+{
+    writeTable(s, table, Indentor());
     return s;
 }
 
-static QString getFuncName(const AbstractMetaFunction* cppFunc) {
-    static bool hashInitialized = false;
-    static QHash<QString, QString> operatorsHash;
-    if (!hashInitialized) {
-        operatorsHash.insert("operator+", "__add__");
-        operatorsHash.insert("operator+=", "__iadd__");
-        operatorsHash.insert("operator-", "__sub__");
-        operatorsHash.insert("operator-=", "__isub__");
-        operatorsHash.insert("operator*", "__mul__");
-        operatorsHash.insert("operator*=", "__imul__");
-        operatorsHash.insert("operator/", "__div__");
-        operatorsHash.insert("operator/=", "__idiv__");
-        operatorsHash.insert("operator%", "__mod__");
-        operatorsHash.insert("operator%=", "__imod__");
-        operatorsHash.insert("operator<<", "__lshift__");
-        operatorsHash.insert("operator<<=", "__ilshift__");
-        operatorsHash.insert("operator>>", "__rshift__");
-        operatorsHash.insert("operator>>=", "__irshift__");
-        operatorsHash.insert("operator&", "__and__");
-        operatorsHash.insert("operator&=", "__iand__");
-        operatorsHash.insert("operator|", "__or__");
-        operatorsHash.insert("operator|=", "__ior__");
-        operatorsHash.insert("operator^", "__xor__");
-        operatorsHash.insert("operator^=", "__ixor__");
-        operatorsHash.insert("operator==", "__eq__");
-        operatorsHash.insert("operator!=", "__ne__");
-        operatorsHash.insert("operator<", "__lt__");
-        operatorsHash.insert("operator<=", "__le__");
-        operatorsHash.insert("operator>", "__gt__");
-        operatorsHash.insert("operator>=", "__ge__");
-        hashInitialized = true;
-    }
+static QHash<QString, QString> createOperatorsHash()
+{
+    QHash<QString, QString> operatorsHash;
+    operatorsHash.insert("operator+", "__add__");
+    operatorsHash.insert("operator+=", "__iadd__");
+    operatorsHash.insert("operator-", "__sub__");
+    operatorsHash.insert("operator-=", "__isub__");
+    operatorsHash.insert("operator*", "__mul__");
+    operatorsHash.insert("operator*=", "__imul__");
+    operatorsHash.insert("operator/", "__div__");
+    operatorsHash.insert("operator/=", "__idiv__");
+    operatorsHash.insert("operator%", "__mod__");
+    operatorsHash.insert("operator%=", "__imod__");
+    operatorsHash.insert("operator<<", "__lshift__");
+    operatorsHash.insert("operator<<=", "__ilshift__");
+    operatorsHash.insert("operator>>", "__rshift__");
+    operatorsHash.insert("operator>>=", "__irshift__");
+    operatorsHash.insert("operator&", "__and__");
+    operatorsHash.insert("operator&=", "__iand__");
+    operatorsHash.insert("operator|", "__or__");
+    operatorsHash.insert("operator|=", "__ior__");
+    operatorsHash.insert("operator^", "__xor__");
+    operatorsHash.insert("operator^=", "__ixor__");
+    operatorsHash.insert("operator==", "__eq__");
+    operatorsHash.insert("operator!=", "__ne__");
+    operatorsHash.insert("operator<", "__lt__");
+    operatorsHash.insert("operator<=", "__le__");
+    operatorsHash.insert("operator>", "__gt__");
+    operatorsHash.insert("operator>=", "__ge__");
+    return operatorsHash;
+}
 
+// Built before any thread can use it.
+static const QHash<QString, QString> operatorsHash = createOperatorsHash();
+
+static QString getFuncName(const AbstractMetaFunction* cppFunc) {
     QHash<QString, QString>::const_iterator it = operatorsHash.find(cppFunc->name());
     QString result = it != operatorsHash.end() ? it.value() : cppFunc->name();
     return result.replace("::", ".");
 }
 
-QtDocGenerator::QtDocGenerator() : m_docParser(new QtDocParser)
+QtDocGenerator::QtDocGenerator()
+    : m_docParser(new QtDocParser), m_codeSnippetIndex(new CodeSnippetIndex),
+      m_conversionCache(new ConversionCache), m_useConversionCache(false)
 {
 }
 
 QtDocGenerator::~QtDocGenerator()
 {
+    // The contexts of the worker threads went away with them.
+    m_contexts.setLocalData(0);
     delete m_docParser;
+    delete m_codeSnippetIndex;
+    delete m_conversionCache;
+}
+
+QtDocGenerator::GenerationContext& QtDocGenerator::context()
+{
+    if (!m_contexts.hasLocalData())
+        m_contexts.setLocalData(new GenerationContext(this));
+    return *m_contexts.localData();
 }
 
 QString QtDocGenerator::fileNameForClass(const AbstractMetaClass* cppClass) const
@@ -922,14 +1138,14 @@ QString QtDocGenerator::fileNameForClass(const AbstractMetaClass* cppClass) cons
 
 void QtDocGenerator::writeFormatedText(QTextStream& s, const Documentation& doc, const AbstractMetaClass* metaClass)
 {
+    Indentor& indentor = context().indentor;
     QString metaClassName;
 
     if (metaClass)
         metaClassName = getClassTargetFullName(metaClass);
 
     if (doc.format() == Documentation::Native) {
-        QtXmlToSphinx x(this, doc.value(), metaClassName);
-        s << x;
+        s << context().xmlToSphinx.convert(doc.value(), metaClassName);
     } else {
         QStringList lines = doc.value().split("\n");
         QRegExp regex("\\S"); // non-space character
@@ -941,20 +1157,37 @@ void QtDocGenerator::writeFormatedText(QTextStream& s, const Documentation& doc,
                 typesystemIndentation = qMin(typesystemIndentation, idx);
         }
         foreach (QString line, lines)
-            s << INDENT << line.remove(0, typesystemIndentation) << endl;
+            s << indentor << line.remove(0, typesystemIndentation) << endl;
     }
 
     s << endl;
 }
 
-static void writeInheritedByList(QTextStream& s, const AbstractMetaClass* metaClass, const AbstractMetaClassList& allClasses)
+/**
+*   Name of the qdoc3 file QtDocParser reads for metaClass. The parser keeps its naming
+*   private, this copies ApiExtractor's QtDocParser::fillDocumentation() and must follow
+*   it, as must the warning generateClass() gives in its place for missing files. Should
+*   they differ, every class with documentation would be reported as having none.
+*/
+static QString docFileName(const AbstractMetaClass* metaClass)
 {
-    AbstractMetaClassList res;
-    foreach (AbstractMetaClass* c, allClasses) {
-        if (c != metaClass && c->inheritsFrom(metaClass))
-            res << c;
-    }
+    return metaClass->qualifiedCppName().toLower().replace("::", "-") + ".xml";
+}
+
+// Drops the documentation filled by the parser, it isn't needed once the class was written.
+static void releaseDocumentation(AbstractMetaClass* metaClass)
+{
+    metaClass->setDocumentation(Documentation());
+    foreach (AbstractMetaFunction* func, metaClass->functions())
+        func->setDocumentation(Documentation());
+    foreach (AbstractMetaEnum* metaEnum, metaClass->enums())
+        metaEnum->setDocumentation(Documentation());
+    foreach (AbstractMetaField* field, metaClass->fields())
+        field->AbstractMetaAttributes::setDocumentation(Documentation());
+}
 
+static void writeInheritedByList(QTextStream& s, const AbstractMetaClassList& res)
+{
     if (res.isEmpty())
         return;
 
@@ -967,12 +1200,25 @@ static void writeInheritedByList(QTextStream& s, const AbstractMetaClass* metaCl
 
 void QtDocGenerator::generateClass(QTextStream& s, const AbstractMetaClass* metaClass)
 {
-    ReportHandler::debugSparse("Generating Documentation for " + metaClass->fullName());
-
-    m_packages[metaClass->package()] << fileNameForClass(metaClass);
+    {
+        QMutexLocker locker(&reportHandlerMutex());
+        ReportHandler::debugSparse("Generating Documentation for " + metaClass->fullName());
+    }
 
-    m_docParser->setPackageName(metaClass->package());
-    m_docParser->fillDocumentation(const_cast<AbstractMetaClass*>(metaClass));
+    // Classes without a qdoc3 file are told apart by the index, without going through the parser.
+    QString docFile = docFileName(metaClass);
+    if (m_docFiles.contains(docFile)) {
+        // The parser only reports the qdoc3 files it can't find, which the index ruled out,
+        // so the other threads keep using ReportHandler meanwhile.
+        QMutexLocker locker(&m_docParserMutex);
+        m_docParser->setPackageName(metaClass->package());
+        m_docParser->fillDocumentation(const_cast<AbstractMetaClass*>(metaClass));
+    } else {
+        QMutexLocker locker(&reportHandlerMutex());
+        // The warning QtDocParser would give.
+        ReportHandler::warning("Can't find qdoc3 file for class " + metaClass->name()
+                               + ", tried: " + m_docDataDir + '/' + docFile);
+    }
 
     s << ".. module:: " << metaClass->package() << endl;
     QString className = getClassTargetFullName(metaClass, false);
@@ -985,12 +1231,13 @@ void QtDocGenerator::generateClass(QTextStream& s, const AbstractMetaClass* meta
       << "    :parts: 2" << endl << endl; // TODO: This would be a parameter in the future...
 
 
-    writeInheritedByList(s, metaClass, classes());
+    writeInheritedByList(s, allSubclasses(metaClass));
 
     if (metaClass->typeEntry() && (metaClass->typeEntry()->version() != 0))
         s << ".. note:: This class was introduced in Qt " << metaClass->typeEntry()->version() << endl;
 
-    writeFunctionList(s, metaClass);
+    const QSet<const AbstractMetaFunction*> skipped = skippedFunctions(metaClass);
+    writeFunctionList(s, metaClass, skipped);
 
     //Function list
     AbstractMetaFunctionList functionList = metaClass->functions();
@@ -1011,7 +1258,7 @@ void QtDocGenerator::generateClass(QTextStream& s, const AbstractMetaClass* meta
 
 
     foreach (AbstractMetaFunction* func, functionList) {
-        if (shouldSkip(func))
+        if (skipped.contains(func))
             continue;
 
         if (func->isStatic())
@@ -1023,9 +1270,17 @@ void QtDocGenerator::generateClass(QTextStream& s, const AbstractMetaClass* meta
     }
 
     writeInjectDocumentation(s, DocModification::Append, metaClass, 0);
+
+    releaseDocumentation(const_cast<AbstractMetaClass*>(metaClass));
 }
 
-void QtDocGenerator::writeFunctionList(QTextStream& s, const AbstractMetaClass* cppClass)
+void QtDocGenerator::classGenerated(const AbstractMetaClass* metaClass)
+{
+    m_packages[metaClass->package()] << fileNameForClass(metaClass);
+}
+
+void QtDocGenerator::writeFunctionList(QTextStream& s, const AbstractMetaClass* cppClass,
+                                       const QSet<const AbstractMetaFunction*>& skipped)
 {
     QStringList functionList;
     QStringList virtualList;
@@ -1034,7 +1289,7 @@ void QtDocGenerator::writeFunctionList(QTextStream& s, const AbstractMetaClass*
     QStringList staticFunctionList;
 
     foreach (AbstractMetaFunction* func, cppClass->functions()) {
-        if (shouldSkip(func))
+        if (skipped.contains(func))
             continue;
 
         QString className;
@@ -1084,6 +1339,7 @@ void QtDocGenerator::writeFunctionList(QTextStream& s, const AbstractMetaClass*
 
 void QtDocGenerator::writeFunctionBlock(QTextStream& s, const QString& title, QStringList& functions)
 {
+    Indentor& indentor = context().indentor;
     if (functions.size() > 0) {
         s << title << endl
           << QString('^').repeated(title.size()) << endl;
@@ -1091,9 +1347,9 @@ void QtDocGenerator::writeFunctionBlock(QTextStream& s, const QString& title, QS
         qSort(functions);
 
         s << ".. container:: function_list" << endl << endl;
-        Indentation indentation(INDENT);
+        Indentation indentation(indentor);
         foreach (QString func, functions)
-            s << '*' << INDENT << func << endl;
+            s << '*' << indentor << func << endl;
 
         s << endl << endl;
     }
@@ -1126,6 +1382,7 @@ void QtDocGenerator::writeFields(QTextStream& s, const AbstractMetaClass* cppCla
 
 void QtDocGenerator::writeConstructors(QTextStream& s, const AbstractMetaClass* cppClass)
 {
+    Indentor& indentor = context().indentor;
     static const QString sectionTitle = ".. class:: ";
     static const QString sectionTitleSpace = QString(sectionTitle.size(), ' ');
 
@@ -1156,7 +1413,7 @@ void QtDocGenerator::writeConstructors(QTextStream& s, const AbstractMetaClass*
     s << endl;
 
     foreach (AbstractMetaArgument* arg, arg_map.values()) {
-        Indentation indentation(INDENT);
+        Indentation indentation(indentor);
         writeParamerteType(s, cppClass, arg);
     }
 
@@ -1214,7 +1471,8 @@ void QtDocGenerator::writeDocSnips(QTextStream &s,
                                  CodeSnip::Position position,
                                  TypeSystem::Language language)
 {
-    Indentation indentation(INDENT);
+    Indentor& indentor = context().indentor;
+    Indentation indentation(indentor);
     QStringList invalidStrings;
     const static QString startMarkup("[sphinx-begin]");
     const static QString endMarkup("[sphinx-end]");
@@ -1277,7 +1535,8 @@ bool QtDocGenerator::writeInjectDocumentation(QTextStream& s,
                                             const AbstractMetaClass* cppClass,
                                             const AbstractMetaFunction* func)
 {
-    Indentation indentation(INDENT);
+    Indentor& indentor = context().indentor;
+    Indentation indentation(indentor);
     bool didSomething = false;
 
     foreach (DocModification mod, cppClass->typeEntry()->docModifications()) {
@@ -1377,13 +1636,15 @@ QString QtDocGenerator::translateToPythonType(const AbstractMetaType* type, cons
 
 void QtDocGenerator::writeParamerteType(QTextStream& s, const AbstractMetaClass* cppClass, const AbstractMetaArgument* arg)
 {
-    s << INDENT << ":param " << arg->name() << ": "
+    Indentor& indentor = context().indentor;
+    s << indentor << ":param " << arg->name() << ": "
       << translateToPythonType(arg->type(), cppClass) << endl;
 }
 
 void QtDocGenerator::writeFunctionParametersType(QTextStream& s, const AbstractMetaClass* cppClass, const AbstractMetaFunction* func)
 {
-    Indentation indentation(INDENT);
+    Indentor& indentor = context().indentor;
+    Indentation indentation(indentor);
 
     s << endl;
     foreach (AbstractMetaArgument* arg, func->arguments()) {
@@ -1409,7 +1670,7 @@ void QtDocGenerator::writeFunctionParametersType(QTextStream& s, const AbstractM
 
         if (retType.isEmpty())
             retType = translateToPythonType(func->type(), cppClass);
-        s << INDENT << ":rtype: " << retType << endl;
+        s << indentor << ":rtype: " << retType << endl;
     }
     s << endl;
 }
@@ -1433,7 +1694,7 @@ void QtDocGenerator::writeFunction(QTextStream& s, bool writeDoc, const Abstract
     }
 }
 
-static void writeFancyToc(QTextStream& s, const QStringList& items, int cols = 4)
+static void writeFancyToc(QTextStream& s, const QStringList& items, const Indentor& indentor, int cols = 4)
 {
     typedef QMap<QChar, QStringList> TocMap;
     TocMap tocMap;
@@ -1488,80 +1749,214 @@ static void writeFancyToc(QTextStream& s, const QStringList& items, int cols = 4
     table << row;
     table.normalize();
     s << ".. container:: pysidetoc" << endl << endl;
-    s << table;
+    // The table is the content of the container, at the indentation of the caller.
+    writeTable(s, table, indentor);
+}
+
+/**
+*   Puts a hard link to source at target, or a copy of it where links aren't
+*   supported, e.g. when the two are in different file systems.
+*/
+static bool linkOrCopyFile(const QString& source, const QString& target)
+{
+    if (QFile::exists(target))
+        QFile::remove(target);
+#ifdef Q_OS_UNIX
+    if (::link(QFile::encodeName(source).constData(), QFile::encodeName(target).constData()) == 0)
+        return true;
+#endif
+    return QFile::copy(source, target);
 }
 
+/// Copies the extra sections of a package to its output directory.
+class ExtraSectionsCopyTask : public QRunnable
+{
+public:
+    typedef QPair<QString, QString> FilePair;
+
+    void run()
+    {
+        foreach (const FilePair& file, files) {
+            if (!linkOrCopyFile(file.first, file.second)) {
+                QMutexLocker locker(&reportHandlerMutex());
+                ReportHandler::warning("Error copying extra doc " + file.first + " to " + file.second);
+            }
+        }
+    }
+
+    QList<FilePair> files;
+};
+
+class QtDocGenerator::PackageIndexTask : public QRunnable
+{
+public:
+    PackageIndexTask(QtDocGenerator* generator, const QString& package, const QStringList& fileNames)
+        : m_generator(generator), m_package(package), m_fileNames(fileNames) {}
+
+    void run()
+    {
+        ProfileScope scope(m_generator->name(), m_package);
+        m_generator->writePackageIndex(m_package, m_fileNames);
+    }
+
+private:
+    QtDocGenerator* m_generator;
+    QString m_package;
+    QStringList m_fileNames;
+};
+
 void QtDocGenerator::finishGeneration()
 {
+    ReportHandler::debugSparse(QString("Code snippet lookups avoided: %1").arg(m_codeSnippetIndex->avoidedProbes()));
+    QMap<QString, int> tagHits = QtXmlToSphinx::tagHitCounts();
+    for (QMap<QString, int>::const_iterator it = tagHits.constBegin(); it != tagHits.constEnd(); ++it)
+        ReportHandler::debugMedium(QString("Documentation tag %1: %2 hits").arg(it.key()).arg(it.value()));
     if (classes().isEmpty())
         return;
 
+    // Packages are independent, as are the copies of their extra sections,
+    // which go on while the indexes are written.
+    QThreadPool pool;
+    pool.setMaxThreadCount(numberOfJobs());
+    bool parallel = numberOfJobs() > 1;
+
     QMap<QString, QStringList>::iterator it = m_packages.begin();
     for (; it != m_packages.end(); ++it) {
         QString outputDir = outputDirectory() + '/' + QString(it.key()).replace(".", "/");
-        FileOut output(outputDir + "/index.rst");
-        QTextStream& s = output.stream;
-
-        s << ".. module:: " << it.key() << endl << endl;
-
-        QString title = it.key();
-        s << title << endl;
-        s << createRepeatedChar(title.length(), '*') << endl << endl;
-
-        /* Avoid showing "Detailed Description for *every* class in toc tree */
-        Indentation indentation(INDENT);
 
         // Search for extra-sections
         if (!m_extraSectionDir.isEmpty()) {
             QDir extraSectionDir(m_extraSectionDir);
             QStringList fileList = extraSectionDir.entryList(QStringList() << (it.key() + "?*.rst"), QDir::Files);
+            ExtraSectionsCopyTask* copyTask = new ExtraSectionsCopyTask;
             QStringList::iterator it2 = fileList.begin();
             for (; it2 != fileList.end(); ++it2) {
                 QString origFileName(*it2);
                 it2->remove(0, it.key().count() + 1);
-                QString newFilePath = outputDir + '/' + *it2;
-                if (QFile::exists(newFilePath))
-                    QFile::remove(newFilePath);
-                if (!QFile::copy(m_extraSectionDir + '/' + origFileName, newFilePath)) {
-                    ReportHandler::warning("Error copying extra doc " + (m_extraSectionDir + '/' + origFileName)
-                                           + " to " + newFilePath);
-                }
+                copyTask->files << ExtraSectionsCopyTask::FilePair(m_extraSectionDir + '/' + origFileName,
+                                                                   outputDir + '/' + *it2);
             }
             it.value().append(fileList);
+            startTask(pool, copyTask, parallel);
         }
 
-        writeFancyToc(s, it.value());
+        startTask(pool, new PackageIndexTask(this, it.key(), it.value()), parallel);
+    }
+    pool.waitForDone();
+}
 
-        s << INDENT << ".. container:: hide" << endl << endl;
-        {
-            Indentation indentation(INDENT);
-            s << INDENT << ".. toctree::" << endl;
-            Indentation deeperIndentation(INDENT);
-            s << INDENT << ":maxdepth: 1" << endl << endl;
-            foreach (QString className, it.value())
-                s << INDENT << className << endl;
-            s << endl << endl;
-        }
+void QtDocGenerator::saveGenerationState()
+{
+    // Shard runs convert documentation too, each one keeps its own cache.
+    if (m_useConversionCache) {
+        int hits = m_conversionCache->hits();
+        ReportHandler::debugSparse(QString("Documentation conversions reused: %1 of %2")
+                                   .arg(hits).arg(hits + m_conversionCache->misses()));
+        if (!m_conversionCache->save())
+            ReportHandler::warning("Couldn't write the documentation conversion cache of " + QString(name()));
+    }
+}
+
+void QtDocGenerator::startTask(QThreadPool& pool, QRunnable* task, bool parallel)
+{
+    if (parallel) {
+        pool.start(task);
+    } else {
+        task->run();
+        delete task;
+    }
+}
+
+void QtDocGenerator::writePackageIndex(const QString& package, const QStringList& fileNames)
+{
+    Indentor& indentor = context().indentor;
+    QString outputDir = outputDirectory() + '/' + QString(package).replace(".", "/");
+    FileOut output(outputDir + "/index.rst");
+    QTextStream& s = output.stream;
+
+    s << ".. module:: " << package << endl << endl;
+
+    QString title = package;
+    s << title << endl;
+    s << createRepeatedChar(title.length(), '*') << endl << endl;
+
+    /* Avoid showing "Detailed Description for *every* class in toc tree */
+    Indentation indentation(indentor);
+
+    writeFancyToc(s, fileNames, indentor);
+
+    s << indentor << ".. container:: hide" << endl << endl;
+    {
+        Indentation indentation(indentor);
+        s << indentor << ".. toctree::" << endl;
+        Indentation deeperIndentation(indentor);
+        s << indentor << ":maxdepth: 1" << endl << endl;
+        foreach (QString className, fileNames)
+            s << indentor << className << endl;
+        s << endl << endl;
+    }
 
-        s << "Detailed Description" << endl;
-        s << "--------------------" << endl << endl;
+    s << "Detailed Description" << endl;
+    s << "--------------------" << endl << endl;
 
-        // module doc is always wrong and C++istic, so go straight to the extra directory!
-        QFile moduleDoc(m_extraSectionDir + '/' + it.key() + ".rst");
-        if (moduleDoc.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            s << moduleDoc.readAll();
-            moduleDoc.close();
+    // module doc is always wrong and C++istic, so go straight to the extra directory!
+    QFile moduleDoc(m_extraSectionDir + '/' + package + ".rst");
+    if (moduleDoc.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        s << moduleDoc.readAll();
+        moduleDoc.close();
+    } else {
+        // try the normal way
+        Documentation moduleDoc;
+        {
+            QMutexLocker parserLocker(&m_docParserMutex);
+            QMutexLocker locker(&reportHandlerMutex());
+            moduleDoc = m_docParser->retrieveModuleDocumentation(package);
+        }
+        if (moduleDoc.format() == Documentation::Native) {
+            s << context().xmlToSphinx.convert(moduleDoc.value(), QString(package).remove(0, package.lastIndexOf('.') + 1));
         } else {
-            // try the normal way
-            Documentation moduleDoc = m_docParser->retrieveModuleDocumentation(it.key());
-            if (moduleDoc.format() == Documentation::Native) {
-                QtXmlToSphinx x(this, moduleDoc.value(), QString(it.key()).remove(0, it.key().lastIndexOf('.') + 1));
-                s << x;
-            } else {
-                s << moduleDoc.value();
-            }
+            s << moduleDoc.value();
         }
     }
+
+    // FileOut reports the files it writes.
+    QMutexLocker locker(&reportHandlerMutex());
+    output.done();
+}
+
+QByteArray QtDocGenerator::conversionCacheSalt(const QMap<QString, QString>& args) const
+{
+    // Everything besides the XML and its context that changes the reST: the generator
+    // build and options, the classes and methods links are resolved with and the
+    // names of the types known to the type system.
+    QStringList data;
+    data << buildId() << outputDirectory() << packageName() << moduleName();
+    QMap<QString, QString> outputArgs = outputArguments(args);
+    QMap<QString, QString>::const_iterator it = outputArgs.constBegin();
+    for (; it != outputArgs.constEnd(); ++it)
+        data << it.key() + '=' + it.value();
+
+    foreach (const AbstractMetaClass* metaClass, classes()) {
+        data << "class " + metaClass->qualifiedCppName();
+        foreach (const AbstractMetaFunction* func, metaClass->functions())
+            data << func->name() + ' ' + (func->implementingClass() ? func->implementingClass()->name() : QString());
+    }
+
+    QStringList typeNames;
+    TypeEntryHash entries = TypeDatabase::instance()->allEntries();
+    for (TypeEntryHash::const_iterator entry = entries.constBegin(); entry != entries.constEnd(); ++entry) {
+        foreach (const TypeEntry* type, entry.value())
+            typeNames << entry.key() + '=' + type->qualifiedTargetLangName();
+    }
+    typeNames.sort();
+    data << typeNames;
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    foreach (const QString& item, data) {
+        hash.addData(item.toUtf8());
+        hash.addData("", 1);
+    }
+    return hash.result();
 }
 
 bool QtDocGenerator::doSetup(const QMap<QString, QString>& args)
@@ -1574,6 +1969,7 @@ bool QtDocGenerator::doSetup(const QMap<QString, QString>& args)
 #   define PATH_SEP ":"
 #endif
     m_codeSnippetDirs = args.value("documentation-code-snippets-dir", m_libSourceDir).split(PATH_SEP);
+    m_codeSnippetIndex->setSearchDirectories(m_codeSnippetDirs);
     m_extraSectionDir = args.value("documentation-extra-sections-dir");
 
     if (m_libSourceDir.isEmpty() || m_docDataDir.isEmpty()) {
@@ -1583,7 +1979,12 @@ bool QtDocGenerator::doSetup(const QMap<QString, QString>& args)
     } else {
         m_docParser->setDocumentationDataDirectory(m_docDataDir);
         m_docParser->setLibrarySourceDirectory(m_libSourceDir);
+        m_docFiles = QDir(m_docDataDir).entryList(QStringList("*.xml"), QDir::Files).toSet();
     }
+
+    m_useConversionCache = incrementalGeneration();
+    if (m_useConversionCache)
+        m_conversionCache->load(stateFileName("rstcache"), conversionCacheSalt(args));
     return true;
 }
 
@@ -23,14 +23,24 @@
 #ifndef DOCGENERATOR_H
 #define DOCGENERATOR_H
 
+#include <QtCore/QAtomicInt>
 #include <QtCore/QStack>
 #include <QtCore/QHash>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QRunnable>
+#include <QtCore/QSet>
 #include <QtCore/QTextStream>
+#include <QtCore/QThreadPool>
+#include <QtCore/QThreadStorage>
+#include <QtCore/QVector>
 #include <QXmlStreamReader>
 #include <abstractmetalang.h>
 #include "generator.h"
 
 class QtDocParser;
+class CodeSnippetIndex;
+class ConversionCache;
 class AbstractMetaFunction;
 class AbstractMetaClass;
 class QXmlStreamReader;
@@ -44,12 +54,15 @@ public:
         short rowSpan;
         short colSpan;
         QString data;
+        // The lines of data and the length of the longest one, set by Table::normalize().
+        QStringList lines;
+        int width;
 
-        TableCell(const QString& text = QString()) : rowSpan(0), colSpan(0), data(text) {}
-        TableCell(const char* text) : rowSpan(0), colSpan(0), data(text) {}
+        TableCell(const QString& text = QString()) : rowSpan(0), colSpan(0), data(text), width(0) {}
+        TableCell(const char* text) : rowSpan(0), colSpan(0), data(text), width(0) {}
     };
 
-    typedef QList<TableCell> TableRow;
+    typedef QVector<TableCell> TableRow;
     class Table : public QList<TableRow>
     {
         public:
@@ -67,6 +80,10 @@ public:
                 return m_hasHeader;
             }
 
+            /**
+            *   Expands the row and column spans into cells with a span of -1 and
+            *   merges the cells past the columns of the first row into its last one.
+            */
             void normalize();
 
             bool isNormalized() const
@@ -80,11 +97,30 @@ public:
             }
 
         private:
+            void measureCells();
+
             bool m_hasHeader;
             bool m_normalized;
     };
 
+    /// Creates a converter that can be reused for any number of documents with convert().
+    explicit QtXmlToSphinx(QtDocGenerator* generator);
+    /**
+    *   Creates a reusable converter whose output continues the indentation of indentor,
+    *   that must outlive the converter.
+    */
+    QtXmlToSphinx(QtDocGenerator* generator, Indentor& indentor);
     QtXmlToSphinx(QtDocGenerator* generator, const QString& doc, const QString& context = QString());
+    ~QtXmlToSphinx();
+
+    /**
+    *   Converts doc, resetting all the state left by the previous document.
+    *   Conversions are taken from the generator's conversion cache when it has one.
+    */
+    QString convert(const QString& doc, const QString& context = QString());
+
+    /// Number of times each tag was found by all the converters, unknown tags are counted as "<unknown>".
+    static QMap<QString, int> tagHitCounts();
 
     QString result() const
     {
@@ -124,7 +160,20 @@ private:
     void handleAnchorTag(QXmlStreamReader& reader);
 
     typedef void (QtXmlToSphinx::*TagHandler)(QXmlStreamReader&);
-    QHash<QString, TagHandler> m_handlerMap;
+    struct TagHandlerEntry
+    {
+        const char* tagName;
+        TagHandler handler;
+    };
+    static const TagHandlerEntry tagHandlers[];
+    static const int tagCount;
+    static QAtomicInt tagHits[];
+
+    enum { UnknownTag = -1 };
+    /// Index of tagName in tagHandlers, or UnknownTag.
+    static int tagId(const QStringRef& tagName);
+    bool lastTagWasCode() const;
+
     QStack<TagHandler> m_handlers;
     QTextStream m_output;
     QString m_result;
@@ -138,10 +187,24 @@ private:
     QtDocGenerator* m_generator;
     bool m_insideBold;
     bool m_insideItalic;
-    QString m_lastTagName;
+    int m_lastTag;
     QString m_opened_anchor;
-
-    QString readFromLocations(const QStringList& locations, const QString& path, const QString& identifier);
+    // Cleared when the conversion read files or reported warnings, it can't be cached then.
+    bool m_cacheable;
+    Indentor m_ownIndentor;
+    Indentor& m_indentor;
+
+    // State of the tags whose handlers need it between their tokens.
+    QString m_heading;
+    char m_headingType;
+    QString m_listType;
+    QString m_linkTag;
+    QString m_linkRef;
+    QString m_linkText;
+    QString m_linkTagEnding;
+    QString m_linkType;
+
+    QString readFromLocations(const QString& path, const QString& identifier);
     QString readFromLocation(const QString& location, const QString& identifier, bool* ok = 0);
     void pushOutputBuffer();
     QString popOutputBuffer();
@@ -153,6 +216,7 @@ inline QTextStream& operator<<(QTextStream& s, const QtXmlToSphinx& xmlToSphinx)
     return s << xmlToSphinx.result();
 }
 
+/// Writes a normalized table without indentation.
 QTextStream& operator<<(QTextStream& s, const QtXmlToSphinx::Table &table);
 
 /**
@@ -183,15 +247,52 @@ public:
         return m_codeSnippetDirs;
     }
 
+    CodeSnippetIndex* codeSnippetIndex() const
+    {
+        return m_codeSnippetIndex;
+    }
+
+    /// Cache of the converted documentation, or 0 when incremental generation is disabled.
+    ConversionCache* conversionCache() const
+    {
+        return m_useConversionCache ? m_conversionCache : 0;
+    }
+
+    Capabilities capabilities() const
+    {
+        return ThreadSafeClassGeneration;
+    }
+
 protected:
     QString fileNameForClass(const AbstractMetaClass* cppClass) const;
     void generateClass(QTextStream& s, const AbstractMetaClass* metaClass);
+    void classGenerated(const AbstractMetaClass* metaClass);
     void finishGeneration();
+    void saveGenerationState();
 
     void writeFunctionArguments(QTextStream&, const AbstractMetaFunction*, Options) const {}
     void writeArgumentNames(QTextStream&, const AbstractMetaFunction*, Options) const {}
 
 private:
+    /**
+    *   State used while writing a class, each thread generating classes has its own.
+    *   The converter continues the indentation of the rest of the class documentation.
+    */
+    struct GenerationContext
+    {
+        explicit GenerationContext(QtDocGenerator* generator) : xmlToSphinx(generator, indentor) {}
+
+        Indentor indentor;
+        QtXmlToSphinx xmlToSphinx;
+    };
+    GenerationContext& context();
+
+    class PackageIndexTask;
+    /// Writes the index.rst of package, listing the given files.
+    void writePackageIndex(const QString& package, const QStringList& fileNames);
+    /// Hands task to pool, or runs it right away when not running in parallel.
+    static void startTask(QThreadPool& pool, QRunnable* task, bool parallel);
+
     void writeEnums(QTextStream& s, const AbstractMetaClass* cppClass);
 
     void writeFields(QTextStream &s, const AbstractMetaClass *cppClass);
@@ -199,7 +300,8 @@ private:
     void writeFunctionSignature(QTextStream& s, const AbstractMetaClass* cppClass, const AbstractMetaFunction* func);
     void writeFunction(QTextStream& s, bool writeDoc, const AbstractMetaClass* cppClass, const AbstractMetaFunction* func);
     void writeFunctionParametersType(QTextStream &s, const AbstractMetaClass *cppClass, const AbstractMetaFunction* func);
-    void writeFunctionList(QTextStream& s, const AbstractMetaClass* cppClass);
+    void writeFunctionList(QTextStream& s, const AbstractMetaClass* cppClass,
+                           const QSet<const AbstractMetaFunction*>& skipped);
     void writeFunctionBlock(QTextStream& s, const QString& title, QStringList& functions);
     void writeParamerteType(QTextStream &s, const AbstractMetaClass *cppClass, const AbstractMetaArgument *arg);
 
@@ -211,6 +313,7 @@ private:
 
     QString parseArgDocStyle(const AbstractMetaClass *cppClass, const AbstractMetaFunction *func);
     QString translateToPythonType(const AbstractMetaType *type, const AbstractMetaClass *cppClass);
+    QByteArray conversionCacheSalt(const QMap<QString, QString>& args) const;
 
     QString m_docDataDir;
     QString m_libSourceDir;
@@ -219,6 +322,14 @@ private:
     QStringList m_functionList;
     QMap<QString, QStringList> m_packages;
     QtDocParser* m_docParser;
+    // Names of the qdoc3 files found in the documentation data dir.
+    QSet<QString> m_docFiles;
+    // The parser is shared by all the threads generating classes.
+    QMutex m_docParserMutex;
+    CodeSnippetIndex* m_codeSnippetIndex;
+    ConversionCache* m_conversionCache;
+    bool m_useConversionCache;
+    QThreadStorage<GenerationContext*> m_contexts;
 };
 
 #endif // DOCGENERATOR_H
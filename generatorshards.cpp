@@ -0,0 +1,246 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "generatorshards.h"
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QList>
+#include <QtCore/QPair>
+#include <QtCore/QRegExp>
+#include <QtCore/QVector>
+
+static const quint32 COSTS_MAGIC = 0x47524b00; // "GRK\0"
+static const quint32 SHARD_MAGIC = 0x47525300; // "GRS\0"
+static const quint32 SHARD_VERSION = 1;
+
+// Classes whose cost is unknown, e.g. skipped by incremental generation, are recorded with this cost.
+static const int UNKNOWN_COST = -1;
+
+typedef QHash<QString, int> CostHash;
+
+/**
+*   Matches the names of the shard records of a generator, capturing the shard index
+*   and count, but not the other state files the shards keep beside them.
+*/
+static QRegExp shardRecordPattern(const QString& generatorName)
+{
+    return QRegExp(QString("\\.%1\\.shard-(\\d+)-of-(\\d+)").arg(QRegExp::escape(generatorName)));
+}
+
+/// Lists the shard records of a generator in outputDir.
+static QStringList shardRecords(const QDir& outputDir, const QString& generatorName)
+{
+    QRegExp pattern = shardRecordPattern(generatorName);
+    QStringList records;
+    foreach (const QString& fileName, outputDir.entryList(QStringList() << ('.' + generatorName + ".shard-*"),
+                                                          QDir::Files | QDir::Hidden)) {
+        if (pattern.exactMatch(fileName))
+            records << fileName;
+    }
+    return records;
+}
+
+GeneratorShards::GeneratorShards(const QString& outputDirectory, const QString& generatorName)
+    : m_outputDirectory(outputDirectory), m_generatorName(generatorName)
+{
+}
+
+void GeneratorShards::loadCosts()
+{
+    m_previousCosts.clear();
+    QFile file(m_outputDirectory + "/." + m_generatorName + ".costs");
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_5);
+    quint32 magic;
+    quint32 version;
+    in >> magic >> version;
+    if (magic != COSTS_MAGIC || version != SHARD_VERSION)
+        return;
+
+    in >> m_previousCosts;
+    if (in.status() != QDataStream::Ok)
+        m_previousCosts.clear();
+}
+
+bool GeneratorShards::saveCosts() const
+{
+    CostHash costs = m_previousCosts;
+    for (CostHash::const_iterator it = m_costs.constBegin(); it != m_costs.constEnd(); ++it) {
+        if (it.value() != UNKNOWN_COST)
+            costs.insert(it.key(), it.value());
+    }
+
+    QFile file(m_outputDirectory + "/." + m_generatorName + ".costs");
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << COSTS_MAGIC << SHARD_VERSION << costs;
+    return out.status() == QDataStream::Ok;
+}
+
+QSet<QString> GeneratorShards::shardClasses(const QList<QStringList>& groups, const QHash<QString, int>& estimates,
+                                            int index, int count) const
+{
+    // Negated costs, so that sorting puts the most expensive groups first and breaks ties by name.
+    typedef QPair<int, QString> CostedGroup;
+    QList<CostedGroup> costedGroups;
+    QHash<QString, const QStringList*> groupsByName;
+    QSet<QString> result;
+    for (int i = 0; i < groups.size(); ++i) {
+        const QStringList& group = groups[i];
+        if (group.isEmpty())
+            continue;
+
+        int cost = 0;
+        bool known = true;
+        foreach (const QString& className, group) {
+            int classCost;
+            if (m_previousCosts.contains(className)) {
+                classCost = m_previousCosts.value(className);
+            } else if (estimates.contains(className)) {
+                classCost = estimates.value(className);
+            } else {
+                known = false;
+                break;
+            }
+            // Classes faster than the timer resolution still count for something.
+            cost += classCost + 1;
+        }
+
+        if (known) {
+            costedGroups << CostedGroup(-cost, group.first());
+            groupsByName.insert(group.first(), &group);
+        } else if (qHash(group.first()) % uint(count) == uint(index - 1)) {
+            result.unite(group.toSet());
+        }
+    }
+    qSort(costedGroups);
+
+    QVector<qint64> totals(count, 0);
+    foreach (const CostedGroup& costedGroup, costedGroups) {
+        int shard = 0;
+        for (int i = 1; i < count; ++i) {
+            if (totals[i] < totals[shard])
+                shard = i;
+        }
+        totals[shard] -= costedGroup.first;
+        if (shard == index - 1)
+            result.unite(groupsByName.value(costedGroup.second)->toSet());
+    }
+    return result;
+}
+
+void GeneratorShards::addGenerated(const QString& className, int cost)
+{
+    m_costs.insert(className, cost < 0 ? UNKNOWN_COST : cost);
+}
+
+QString GeneratorShards::shardSuffix(int index, int count)
+{
+    return QString(".shard-%1-of-%2").arg(index).arg(count);
+}
+
+bool GeneratorShards::saveShard(int index, int count) const
+{
+    QDir outputDir(m_outputDirectory);
+    QString fileName = '.' + m_generatorName + shardSuffix(index, count);
+    // Shards of a previous split with a different count would confuse the merge.
+    QRegExp pattern = shardRecordPattern(m_generatorName);
+    foreach (const QString& oldShard, shardRecords(outputDir, m_generatorName)) {
+        pattern.exactMatch(oldShard);
+        if (pattern.cap(2).toInt() != count)
+            outputDir.remove(oldShard);
+    }
+
+    QFile file(outputDir.filePath(fileName));
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << SHARD_MAGIC << SHARD_VERSION << qint32(index) << qint32(count) << m_costs;
+    return out.status() == QDataStream::Ok;
+}
+
+bool GeneratorShards::loadShards(QSet<QString>* classNames, QString* errorMessage)
+{
+    QDir outputDir(m_outputDirectory);
+    QStringList shardFiles = shardRecords(outputDir, m_generatorName);
+    if (shardFiles.isEmpty()) {
+        *errorMessage = "no shards found in " + m_outputDirectory;
+        return false;
+    }
+
+    int count = 0;
+    QSet<int> indexes;
+    foreach (const QString& shardFile, shardFiles) {
+        QFile file(outputDir.filePath(shardFile));
+        if (!file.open(QIODevice::ReadOnly)) {
+            *errorMessage = "can't read " + file.fileName();
+            return false;
+        }
+
+        QDataStream in(&file);
+        in.setVersion(QDataStream::Qt_4_5);
+        quint32 magic;
+        quint32 version;
+        qint32 index;
+        qint32 shardCount;
+        CostHash costs;
+        in >> magic >> version >> index >> shardCount >> costs;
+        if (in.status() != QDataStream::Ok || magic != SHARD_MAGIC || version != SHARD_VERSION) {
+            *errorMessage = file.fileName() + " is not a valid shard";
+            return false;
+        }
+        if (count && shardCount != count) {
+            *errorMessage = QString("shards of splits in %1 and %2 parts found").arg(count).arg(shardCount);
+            return false;
+        }
+        count = shardCount;
+        indexes << index;
+
+        for (CostHash::const_iterator it = costs.constBegin(); it != costs.constEnd(); ++it) {
+            // Shards that didn't see the same costs may split the classes differently.
+            if (classNames->contains(it.key())) {
+                *errorMessage = it.key() + " was generated by several shards";
+                return false;
+            }
+            classNames->insert(it.key());
+            m_costs.insert(it.key(), it.value());
+        }
+    }
+
+    for (int index = 1; index <= count; ++index) {
+        if (!indexes.contains(index)) {
+            *errorMessage = QString("shard %1 of %2 is missing").arg(index).arg(count);
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef GENERATORSHARDS_H
+#define GENERATORSHARDS_H
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+/**
+*   Bookkeeping of a generation split among several runs, each one generating
+*   a shard of the classes, and of the run merging them afterwards.
+*   The output directory keeps the time each class took to be generated by the
+*   last complete run, used to balance the shards, and the classes generated
+*   by each shard, used by the merge.
+*   Classes are identified by their qualified C++ names.
+*/
+class GeneratorShards
+{
+public:
+    GeneratorShards(const QString& outputDirectory, const QString& generatorName);
+
+    /// Reads the class costs recorded by the last complete run.
+    void loadCosts();
+
+    /// Records the class costs measured by this run, keeping the previous cost of the other classes.
+    bool saveCosts() const;
+
+    /**
+    *   Splits groups of classes into count shards and returns the classes of shard
+    *   index, counted from 1. The classes of a group always go to the same shard.
+    *   Groups with a known cost, the sum of the recorded cost or else the estimate
+    *   of each class, are handed from the most expensive to the shard with the lowest
+    *   total cost; the others are spread by a hash of the name of their first class.
+    *   All the shards get the same split as long as they see the same costs.
+    */
+    QSet<QString> shardClasses(const QList<QStringList>& groups, const QHash<QString, int>& estimates,
+                               int index, int count) const;
+
+    /// Records that a class was generated by this run, taking cost milliseconds.
+    void addGenerated(const QString& className, int cost);
+
+    /// Writes the classes generated by this run, as shard index of count.
+    bool saveShard(int index, int count) const;
+
+    /**
+    *   Reads the classes generated by every shard saved in the output directory,
+    *   together with the costs they measured. Fails, with a message in errorMessage,
+    *   if the shards don't belong to the same split, some of them are missing or
+    *   several of them generated the same class.
+    */
+    bool loadShards(QSet<QString>* classNames, QString* errorMessage);
+
+    /// Suffix added by shard index of count to the names of the files it keeps in the output directory.
+    static QString shardSuffix(int index, int count);
+
+private:
+    QString m_outputDirectory;
+    QString m_generatorName;
+    QHash<QString, int> m_previousCosts;
+    QHash<QString, int> m_costs;
+};
+
+#endif // GENERATORSHARDS_H
@@ -24,11 +24,19 @@
 #include <QCoreApplication>
 #include <QLinkedList>
 #include <QLibrary>
+#include <QDateTime>
+#include <QThread>
+#include <QFutureSynchronizer>
+#include <QtConcurrentRun>
 #include <QDomDocument>
+#include <QProcess>
+#include <QRegExp>
+#include <QSet>
 #include <iostream>
 #include <apiextractor.h>
 #include "generatorrunnerconfig.h"
 #include "generator.h"
+#include "profiler.h"
 
 #ifdef _WINDOWS
     #define PATH_SPLITTER ";"
@@ -36,6 +44,11 @@
     #define PATH_SPLITTER ":"
 #endif
 
+#ifdef Q_OS_UNIX
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 static void printOptions(QTextStream& s, const QMap<QString, QString>& options) {
     QMap<QString, QString>::const_iterator it = options.constBegin();
     s.setFieldAlignment(QTextStream::AlignLeft);
@@ -49,6 +62,7 @@ static void printOptions(QTextStream& s, const QMap<QString, QString>& options)
 }
 
 typedef void (*getGeneratorsFunc)(QLinkedList<Generator*>*);
+typedef int (*generatorPluginAbiVersionFunc)();
 
 static bool processProjectFile(QFile& projectFile, QMap<QString, QString>& args)
 {
@@ -179,8 +193,17 @@ void printUsage(const GeneratorList& generators)
     generalOptions.insert("documentation-only", "Do not generates any code, just the documentation");
     generalOptions.insert("license-file=<license-file>", "File used for copyright headers of generated files");
     generalOptions.insert("version", "Output version information and exit");
-    generalOptions.insert("generator-set=<\"generator module\">", "generator-set to be used. e.g. qtdoc");
+    generalOptions.insert("generator-set=<\"generator module\">[,...]", "generator-set to be used. e.g. qtdoc. Generator-sets separated by commas share the same API extraction");
     generalOptions.insert("api-version=<\"version\">", "Specify the supported api version used to generate the bindings");
+    generalOptions.insert("parallel-generators", "Run the generators of the generator-set that do not modify the extracted model at the same time");
+    generalOptions.insert("incremental", "Skip the generation of classes that didn't change since the last run, for generators that support it");
+    generalOptions.insert("jobs[=<number>]", "Number of classes generated in parallel by generators that support it, defaults to the number of CPUs");
+    generalOptions.insert("batch-file=<file>", "Run the project files listed in file, one per line followed by an optional colon, white space and the project files it depends on");
+    generalOptions.insert("batch-jobs=<number>", "Number of projects of the batch file run at the same time, defaults to 1");
+    generalOptions.insert("shard=<index>/<count>", "Generate only one of count shards of the classes, leaving the module files to a run with --merge-shards");
+    generalOptions.insert("merge-shards", "Generate the module files from the shards recorded in the output directory, without generating classes");
+    generalOptions.insert("memory-limit=<megabytes>", "Keep fewer generated files in memory, writing them out when generation grows the process past the limit, and report the peak memory usage");
+    generalOptions.insert("profile=<file>", "Write the time taken by each phase, generator and class to file, in the JSON format of chrome://tracing");
     generalOptions.insert("drop-type-entries=\"<TypeEntry0>[;TypeEntry1;...]\"", "Semicolon separated list of type system entries (classes, namespaces, global functions and enums) to be dropped from generation.");
     printOptions(s, generalOptions);
 
@@ -193,33 +216,19 @@ void printUsage(const GeneratorList& generators)
     }
 }
 
-int main(int argc, char *argv[])
+/**
+*   Loads the generators of a comma separated list of generator-sets, adding to
+*   buildId the identification of each plugin. Prints the error and returns false
+*   if a plugin can't be loaded.
+*/
+static bool loadGenerators(const QString& generatorSet, GeneratorList* generators, QByteArray* buildId, const char* appName)
 {
-    // needed by qxmlpatterns
-    QCoreApplication app(argc, argv);
-
-    // Store command arguments in a map
-    QMap<QString, QString> args = getCommandLineArgs();
-    GeneratorList generators;
-
-    if (args.contains("version")) {
-        std::cout << "generatorrunner v" GENERATORRUNNER_VERSION << std::endl;
-        std::cout << "Copyright (C) 2009-2010 Nokia Corporation and/or its subsidiary(-ies)" << std::endl;
-        return EXIT_SUCCESS;
-    }
-
-    // Try to load a generator
-    QString generatorSet = args.value("generator-set");
-
-    // Also check "generatorSet" command line argument for backward compatibility.
-    if (generatorSet.isEmpty())
-        generatorSet = args.value("generatorSet");
-
-    if (!generatorSet.isEmpty()) {
-        QFileInfo generatorFile(generatorSet);
+    // Several generator-sets may share a single run of the API Extractor.
+    foreach (const QString& setName, generatorSet.split(',', QString::SkipEmptyParts)) {
+        QFileInfo generatorFile(setName);
 
         if (!generatorFile.exists()) {
-            QString generatorSetName(generatorSet + "_generator" + MODULE_EXTENSION);
+            QString generatorSetName(setName + "_generator" + MODULE_EXTENSION);
 
             // More library paths may be added via the QT_PLUGIN_PATH environment variable.
             QCoreApplication::addLibraryPath(GENERATORRUNNER_PLUGIN_DIR);
@@ -231,28 +240,52 @@ int main(int argc, char *argv[])
         }
 
         if (!generatorFile.exists()) {
-            std::cerr << argv[0] << ": Error loading generator-set plugin: ";
+            std::cerr << appName << ": Error loading generator-set plugin: ";
             std::cerr << qPrintable(generatorFile.baseName()) << " module not found." << std::endl;
-            return EXIT_FAILURE;
+            return false;
         }
 
         QLibrary plugin(generatorFile.filePath());
+        generatorPluginAbiVersionFunc abiVersion = (generatorPluginAbiVersionFunc)plugin.resolve("generatorPluginAbiVersion");
+        if (!abiVersion || abiVersion() != GENERATOR_PLUGIN_ABI_VERSION) {
+            std::cerr << appName << ": Error loading generator-set plugin: ";
+            std::cerr << qPrintable(generatorFile.baseName()) << " was built for another generator plugin interface";
+            std::cerr << " (expected version " << GENERATOR_PLUGIN_ABI_VERSION << "), rebuild it against this generatorrunner." << std::endl;
+            return false;
+        }
         getGeneratorsFunc getGenerators = (getGeneratorsFunc)plugin.resolve("getGenerators");
         if (getGenerators) {
-            getGenerators(&generators);
+            getGenerators(generators);
+            *buildId += QString("%1 %2 %3;").arg(generatorFile.absoluteFilePath())
+                                            .arg(generatorFile.size())
+                                            .arg(generatorFile.lastModified().toTime_t()).toUtf8();
         } else {
-            std::cerr << argv[0] << ": Error loading generator-set plugin: " << qPrintable(plugin.errorString()) << std::endl;
-            return EXIT_FAILURE;
+            std::cerr << appName << ": Error loading generator-set plugin: " << qPrintable(plugin.errorString()) << std::endl;
+            return false;
         }
-    } else if (!args.contains("help")) {
-        std::cerr << argv[0] << ": You need to specify a generator with --generator-set=GENERATOR_NAME" << std::endl;
-        return EXIT_FAILURE;
     }
+    return true;
+}
 
-    if (args.contains("help")) {
-        printUsage(generators);
-        return EXIT_SUCCESS;
+static QString generatorSetOf(const QMap<QString, QString>& args)
+{
+    // Also check "generatorSet" command line argument for backward compatibility.
+    QString generatorSet = args.value("generator-set");
+    if (generatorSet.isEmpty())
+        generatorSet = args.value("generatorSet");
+    return generatorSet;
+}
+
+/// Extracts the API described by args and runs the generators over it, returns the exit code.
+static int runGenerators(const QMap<QString, QString>& args, const GeneratorList& generators,
+                         const QByteArray& generatorBuildId, const char* appName)
+{
+    QString profileFileName = args.value("profile");
+    if (args.contains("profile") && profileFileName.isEmpty()) {
+        std::cerr << appName << ": You need to specify a file with --profile=<file>" << std::endl;
+        return EXIT_FAILURE;
     }
+    Profiler::setEnabled(!profileFileName.isEmpty());
 
 
     QString licenseComment;
@@ -306,6 +339,48 @@ int main(int argc, char *argv[])
         extractor.addIncludePath(args.value("include-paths").split(PATH_SPLITTER));
 
 
+    int jobs = 1;
+    if (args.contains("jobs")) {
+        QString value = args.value("jobs");
+        bool ok = true;
+        jobs = value.isEmpty() ? QThread::idealThreadCount() : value.toInt(&ok);
+        if (!ok || jobs < 1) {
+            std::cerr << "Invalid number of jobs: " << qPrintable(value) << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    qint64 memoryLimit = 0;
+    if (args.contains("memory-limit")) {
+        bool ok = false;
+        memoryLimit = args.value("memory-limit").toLongLong(&ok) * 1024 * 1024;
+        if (!ok || memoryLimit <= 0) {
+            std::cerr << "Invalid memory limit: " << qPrintable(args.value("memory-limit")) << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    int shardIndex = 1;
+    int shardCount = 1;
+    if (args.contains("shard")) {
+        QStringList shard = args.value("shard").split('/');
+        bool indexOk = false;
+        bool countOk = false;
+        if (shard.size() == 2) {
+            shardIndex = shard[0].toInt(&indexOk);
+            shardCount = shard[1].toInt(&countOk);
+        }
+        if (!indexOk || !countOk || shardCount < 1 || shardIndex < 1 || shardIndex > shardCount) {
+            std::cerr << "Invalid shard, expected <index>/<count>: " << qPrintable(args.value("shard")) << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    bool mergeShards = args.contains("merge-shards");
+    if (mergeShards && shardCount > 1) {
+        std::cerr << "--shard and --merge-shards can't be used together" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     QString cppFileName = args.value("arg-1");
     QString typeSystemFileName = args.value("arg-2");
     if (args.contains("arg-3")) {
@@ -314,22 +389,341 @@ int main(int argc, char *argv[])
     }
     extractor.setCppFileName(cppFileName);
     extractor.setTypeSystem(typeSystemFileName);
-    if (!extractor.run())
-        return EXIT_FAILURE;
+    {
+        ProfileScope scope("generatorrunner", "ApiExtractor::run");
+        if (!extractor.run())
+            return EXIT_FAILURE;
+    }
 
     if (!extractor.classCount())
         ReportHandler::warning("No C++ classes found!");
 
+    GeneratorRunContext runContext;
+
+    // Generators that only read the extracted model may run concurrently, after
+    // the ones that modify it have finished.
+    bool parallelGenerators = args.contains("parallel-generators");
+    GeneratorList concurrentGenerators;
     foreach (Generator* g, generators) {
         g->setOutputDirectory(outputDirectory);
         g->setLicenseComment(licenseComment);
-        if (g->setup(extractor, args))
+        g->setNumberOfJobs(jobs);
+        g->setIncrementalGeneration(args.contains("incremental"), generatorBuildId);
+        g->setShard(shardIndex, shardCount);
+        g->setMergeShards(mergeShards);
+        g->setMemoryLimit(memoryLimit);
+        // setup() takes a snapshot of the classes, so that of the concurrent generators
+        // waits until the others are done changing the model.
+        if (parallelGenerators && (g->capabilities() & Generator::ReadOnlyModelAccess))
+            concurrentGenerators << g;
+        else if (g->setup(extractor, args, runContext))
             g->generate();
     }
-    qDeleteAll(generators);
+
+    GeneratorList readyGenerators;
+    foreach (Generator* g, concurrentGenerators) {
+        if (g->setup(extractor, args, runContext))
+            readyGenerators << g;
+    }
+    if (!readyGenerators.isEmpty()) {
+        // The generators reach the same functions and types at the same time.
+        Generator::fillModelCaches(extractor);
+        QFutureSynchronizer<void> synchronizer;
+        foreach (Generator* g, readyGenerators)
+            synchronizer.addFuture(QtConcurrent::run(g, &Generator::generate));
+        synchronizer.waitForFinished();
+    }
+
+    if (!profileFileName.isEmpty() && !Profiler::save(profileFileName)) {
+        std::cerr << "Couldn't write the profile file: " << qPrintable(profileFileName) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    qint64 peakMemory = Profiler::peakResidentMemory() / (1024 * 1024);
+    if (memoryLimit) {
+        std::cout << "Peak memory usage: " << peakMemory << " MB of " << memoryLimit / (1024 * 1024) << " MB" << std::endl;
+        if (peakMemory > memoryLimit / (1024 * 1024))
+            ReportHandler::warning("The peak memory usage exceeded the memory limit, the extracted model doesn't count towards it.");
+    } else {
+        ReportHandler::debugSparse(QString("Peak memory usage: %1 MB").arg(peakMemory));
+    }
+
+    bool failed = false;
+    foreach (Generator* g, generators) {
+        if (g->generationFailed())
+            failed = true;
+    }
 
     ReportHandler::flush();
     std::cout << "Done, " << ReportHandler::warningCount();
     std::cout << " warnings (" << ReportHandler::suppressedCount() << " known issues)";
     std::cout << std::endl;
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/// A project of a batch file, run once the projects it depends on succeeded.
+struct BatchJob
+{
+    QString projectFileName;
+    QStringList dependencies;
+    QMap<QString, QString> args;
+};
+
+/**
+*   Reads a batch file: one project file per line, optionally followed by a colon
+*   and the project files, listed in the same batch, it depends on. Only a colon
+*   followed by white space or ending the line separates them, so that Windows drive
+*   letters stay in the paths. Relative paths are relative to the batch file. Empty
+*   lines and lines starting with '#' are skipped.
+*/
+static bool readBatchFile(const QString& batchFileName, QList<BatchJob>* jobs, const char* appName)
+{
+    QFile batchFile(batchFileName);
+    if (!batchFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        std::cerr << appName << ": Can't read the batch file \"" << qPrintable(batchFileName) << "\"." << std::endl;
+        return false;
+    }
+
+    QDir batchDir = QFileInfo(batchFileName).absoluteDir();
+    QSet<QString> projectFileNames;
+    QRegExp separator(":(\\s|$)");
+    while (!batchFile.atEnd()) {
+        QString line = QString::fromLocal8Bit(batchFile.readLine()).trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        BatchJob job;
+        int split = separator.indexIn(line);
+        job.projectFileName = QDir::cleanPath(batchDir.absoluteFilePath(line.left(split).trimmed()));
+        if (split > 0) {
+            foreach (const QString& dependency, line.mid(split + 1).split(QRegExp("\\s+"), QString::SkipEmptyParts))
+                job.dependencies << QDir::cleanPath(batchDir.absoluteFilePath(dependency));
+        }
+
+        QFile projectFile(job.projectFileName);
+        if (!projectFile.open(QIODevice::ReadOnly) || !processProjectFile(projectFile, job.args)) {
+            std::cerr << appName << ": \"" << qPrintable(job.projectFileName);
+            std::cerr << "\" is not a project file starting with \"[generator-project]\"." << std::endl;
+            return false;
+        }
+        job.args["project-file"] = job.projectFileName;
+        projectFileNames << job.projectFileName;
+        *jobs << job;
+    }
+
+    foreach (const BatchJob& job, *jobs) {
+        foreach (const QString& dependency, job.dependencies) {
+            if (!projectFileNames.contains(dependency)) {
+                std::cerr << appName << ": \"" << qPrintable(job.projectFileName) << "\" depends on \"";
+                std::cerr << qPrintable(dependency) << "\", which is not in the batch." << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/// Gives up the waiting jobs that depend, directly or not, on a failed one.
+static void skipBlockedJobs(const QList<BatchJob>& jobs, QList<int>* waiting, QSet<QString>* failed, const char* appName)
+{
+    bool skipped = true;
+    while (skipped) {
+        skipped = false;
+        foreach (int i, *waiting) {
+            foreach (const QString& dependency, jobs[i].dependencies) {
+                if (failed->contains(dependency)) {
+                    std::cerr << appName << ": Skipping " << qPrintable(jobs[i].projectFileName);
+                    std::cerr << ", a project it depends on failed." << std::endl;
+                    *failed << jobs[i].projectFileName;
+                    waiting->removeOne(i);
+                    skipped = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/// Returns the first waiting job whose dependencies succeeded, or -1 if there is none.
+static int readyJob(const QList<BatchJob>& jobs, const QList<int>& waiting, const QSet<QString>& succeeded)
+{
+    foreach (int i, waiting) {
+        bool ready = true;
+        foreach (const QString& dependency, jobs[i].dependencies)
+            ready = ready && succeeded.contains(dependency);
+        if (ready)
+            return i;
+    }
+    return -1;
+}
+
+/**
+*   Runs the projects of a batch file in one process, with the options given in the
+*   command line overriding those of the projects. The plugins of each generator-set
+*   are loaded once. On UNIX every project runs in a child process forked from this
+*   one, so they don't see each other's type database, and up to batch-jobs of them
+*   run at the same time. This process never loads a type system itself: the forked
+*   projects would inherit it, and their output would depend on what ran before them.
+*/
+static int runBatch(const QMap<QString, QString>& commandLineArgs, const char* appName)
+{
+    QList<BatchJob> jobs;
+    if (!readBatchFile(commandLineArgs.value("batch-file"), &jobs, appName))
+        return EXIT_FAILURE;
+
+    int maxRunning = 1;
+    if (commandLineArgs.contains("batch-jobs")) {
+        bool ok = false;
+        maxRunning = commandLineArgs.value("batch-jobs").toInt(&ok);
+        if (!ok || maxRunning < 1) {
+            std::cerr << "Invalid number of batch jobs: " << qPrintable(commandLineArgs.value("batch-jobs")) << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    QMap<QString, GeneratorList> generatorSets;
+    QMap<QString, QByteArray> buildIds;
+    for (int i = 0; i < jobs.size(); ++i) {
+        QMap<QString, QString>::const_iterator it = commandLineArgs.constBegin();
+        for (; it != commandLineArgs.constEnd(); ++it) {
+            if (it.key() != "batch-file" && it.key() != "batch-jobs")
+                jobs[i].args[it.key()] = it.value();
+        }
+
+        QString generatorSet = generatorSetOf(jobs[i].args);
+        if (generatorSet.isEmpty()) {
+            std::cerr << appName << ": You need to specify a generator for " << qPrintable(jobs[i].projectFileName) << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (!generatorSets.contains(generatorSet)
+            && !loadGenerators(generatorSet, &generatorSets[generatorSet], &buildIds[generatorSet], appName)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    QSet<QString> succeeded;
+    QSet<QString> failed;
+    QList<int> waiting;
+    for (int i = 0; i < jobs.size(); ++i)
+        waiting << i;
+#ifdef Q_OS_UNIX
+    QHash<pid_t, int> running;
+#endif
+
+    forever {
+        skipBlockedJobs(jobs, &waiting, &failed, appName);
+        int ready = readyJob(jobs, waiting, succeeded);
+        int finished = -1;
+        bool success = false;
+#ifdef Q_OS_UNIX
+        if (ready != -1 && running.size() < maxRunning) {
+            waiting.removeOne(ready);
+            const BatchJob& job = jobs[ready];
+            std::cout.flush();
+            pid_t pid = fork();
+            if (pid == 0) {
+                QString generatorSet = generatorSetOf(job.args);
+                int result = runGenerators(job.args, generatorSets[generatorSet], buildIds[generatorSet], appName);
+                std::cout.flush();
+                std::cerr.flush();
+                // The parent owns everything else, including the generators.
+                _exit(result);
+            }
+            if (pid < 0) {
+                std::cerr << appName << ": Can't start " << qPrintable(job.projectFileName) << std::endl;
+                failed << job.projectFileName;
+            } else {
+                running.insert(pid, ready);
+            }
+            continue;
+        }
+        if (running.isEmpty())
+            break;
+
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0)
+            break;
+        if (!running.contains(pid))
+            continue;
+        finished = running.take(pid);
+        success = WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+#else
+        if (ready == -1)
+            break;
+
+        // Without fork() every project gets a process of its own.
+        waiting.removeOne(ready);
+        finished = ready;
+        QStringList arguments;
+        QMap<QString, QString>::const_iterator it = jobs[finished].args.constBegin();
+        for (; it != jobs[finished].args.constEnd(); ++it) {
+            if (it.key().startsWith("arg-"))
+                arguments << it.value();
+            else if (it.key() != "project-file")
+                arguments << (it.value().isEmpty() ? "--" + it.key() : "--" + it.key() + '=' + it.value());
+        }
+        success = QProcess::execute(QCoreApplication::applicationFilePath(), arguments) == EXIT_SUCCESS;
+#endif
+
+        const BatchJob& job = jobs[finished];
+        if (!success) {
+            std::cerr << appName << ": " << qPrintable(job.projectFileName) << " failed." << std::endl;
+            failed << job.projectFileName;
+            continue;
+        }
+        succeeded << job.projectFileName;
+    }
+
+    // Whatever is still waiting depends on itself through other jobs.
+    foreach (int i, waiting) {
+        std::cerr << appName << ": Skipping " << qPrintable(jobs[i].projectFileName);
+        std::cerr << ", its dependencies form a cycle." << std::endl;
+        failed << jobs[i].projectFileName;
+    }
+
+    std::cout << "Batch done, " << succeeded.size() << " of " << jobs.size() << " projects generated" << std::endl;
+    foreach (const GeneratorList& generators, generatorSets)
+        qDeleteAll(generators);
+    return failed.isEmpty() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[])
+{
+    // needed by qxmlpatterns
+    QCoreApplication app(argc, argv);
+
+    // Store command arguments in a map
+    QMap<QString, QString> args = getCommandLineArgs();
+    GeneratorList generators;
+
+    if (args.contains("version")) {
+        std::cout << "generatorrunner v" GENERATORRUNNER_VERSION << std::endl;
+        std::cout << "Copyright (C) 2009-2010 Nokia Corporation and/or its subsidiary(-ies)" << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    if (args.contains("batch-file") && !args.contains("help"))
+        return runBatch(args, argv[0]);
+
+    // Try to load a generator
+    QString generatorSet = generatorSetOf(args);
+    QByteArray generatorBuildId;
+
+    if (!generatorSet.isEmpty()) {
+        if (!loadGenerators(generatorSet, &generators, &generatorBuildId, argv[0]))
+            return EXIT_FAILURE;
+    } else if (!args.contains("help")) {
+        std::cerr << argv[0] << ": You need to specify a generator with --generator-set=GENERATOR_NAME" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (args.contains("help")) {
+        printUsage(generators);
+        return EXIT_SUCCESS;
+    }
+
+    int result = runGenerators(args, generators, generatorBuildId, argv[0]);
+    qDeleteAll(generators);
+    return result;
 }
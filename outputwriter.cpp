@@ -0,0 +1,188 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "outputwriter.h"
+#include "generator.h"
+#include <reporthandler.h>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutex>
+#include <QtCore/QRunnable>
+
+static const quint32 MANIFEST_MAGIC = 0x47524d00; // "GRM\0"
+static const quint32 MANIFEST_VERSION = 1;
+
+// Files generated but not written yet, this bounds the memory they use.
+static const int MAX_PENDING_FILES = 64;
+
+class OutputWriter::WriteTask : public QRunnable
+{
+public:
+    WriteTask(OutputWriter* writer, const QString& filePath, const QByteArray& contents)
+        : m_writer(writer), m_filePath(filePath), m_contents(contents)
+    {
+    }
+
+    void run()
+    {
+        m_writer->writeFile(m_filePath, m_contents);
+        m_writer->m_freeSlots.release();
+    }
+
+private:
+    OutputWriter* m_writer;
+    QString m_filePath;
+    QByteArray m_contents;
+};
+
+OutputWriter::OutputWriter(const QString& outputDirectory, const QString& generatorName)
+    : m_outputDirectory(outputDirectory),
+      m_manifestFileName(outputDirectory + "/." + generatorName + ".manifest"),
+      m_numWritten(0), m_freeSlots(MAX_PENDING_FILES)
+{
+    // A single thread, the files are written in the order they were queued.
+    m_pool.setMaxThreadCount(1);
+    loadManifest();
+}
+
+OutputWriter::~OutputWriter()
+{
+    waitForDone();
+    if (!saveManifest()) {
+        QMutexLocker locker(&reportHandlerMutex());
+        ReportHandler::warning("Couldn't write the output manifest " + m_manifestFileName);
+    }
+}
+
+void OutputWriter::write(const QString& filePath, const QByteArray& contents)
+{
+    m_freeSlots.acquire();
+    m_pool.start(new WriteTask(this, filePath, contents));
+}
+
+void OutputWriter::waitForDone()
+{
+    m_pool.waitForDone();
+}
+
+int OutputWriter::numWritten()
+{
+    waitForDone();
+    return m_numWritten;
+}
+
+void OutputWriter::loadManifest()
+{
+    QFile file(m_manifestFileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_5);
+    quint32 magic;
+    quint32 version;
+    qint32 count;
+    in >> magic >> version >> count;
+    if (magic != MANIFEST_MAGIC || version != MANIFEST_VERSION || count < 0)
+        return;
+
+    for (int i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString filePath;
+        ManifestEntry entry;
+        in >> filePath >> entry.hash >> entry.size >> entry.lastModified;
+        m_manifest.insert(filePath, entry);
+    }
+
+    if (in.status() != QDataStream::Ok)
+        m_manifest.clear();
+}
+
+bool OutputWriter::saveManifest() const
+{
+    QFile file(m_manifestFileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << MANIFEST_MAGIC << MANIFEST_VERSION << qint32(m_manifest.count());
+    ManifestHash::const_iterator it = m_manifest.constBegin();
+    for (; it != m_manifest.constEnd(); ++it)
+        out << it.key() << it.value().hash << it.value().size << it.value().lastModified;
+    return out.status() == QDataStream::Ok;
+}
+
+bool OutputWriter::isUnchanged(const QString& filePath, const QByteArray& contents, const QByteArray& hash) const
+{
+    QFileInfo info(m_outputDirectory + '/' + filePath);
+    if (!info.exists() || info.size() != contents.size())
+        return false;
+
+    // A file still as it was written by a previous run isn't read again.
+    ManifestHash::const_iterator it = m_manifest.find(filePath);
+    if (it != m_manifest.constEnd()
+        && it.value().hash == hash
+        && it.value().size == info.size()
+        && it.value().lastModified == info.lastModified().toTime_t())
+        return true;
+
+    QFile file(info.filePath());
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    return file.readAll() == contents;
+}
+
+void OutputWriter::writeFile(const QString& filePath, const QByteArray& contents)
+{
+    QByteArray hash = QCryptographicHash::hash(contents, QCryptographicHash::Sha1);
+    QString fileName = m_outputDirectory + '/' + filePath;
+
+    if (!isUnchanged(filePath, contents, hash)) {
+        QFile file(fileName);
+        QDir dir = QFileInfo(file).dir();
+        if (!dir.exists() && !dir.mkpath(dir.absolutePath())) {
+            QMutexLocker locker(&reportHandlerMutex());
+            ReportHandler::warning(QString("unable to create directory '%1'").arg(dir.absolutePath()));
+            return;
+        }
+        if (!file.open(QIODevice::WriteOnly) || file.write(contents) != contents.size()) {
+            QMutexLocker locker(&reportHandlerMutex());
+            ReportHandler::warning(QString("failed to write file '%1'").arg(fileName));
+            m_manifest.remove(filePath);
+            return;
+        }
+        file.close();
+        ++m_numWritten;
+    }
+
+    QFileInfo info(fileName);
+    ManifestEntry entry;
+    entry.hash = hash;
+    entry.size = info.size();
+    entry.lastModified = info.lastModified().toTime_t();
+    m_manifest.insert(filePath, entry);
+}
@@ -0,0 +1,83 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef OUTPUTWRITER_H
+#define OUTPUTWRITER_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QSemaphore>
+#include <QtCore/QString>
+#include <QtCore/QThreadPool>
+
+/**
+*   Writes generated files from a background thread, so the generating thread
+*   can go on with the next class while the previous one is written.
+*   A manifest in the output directory records the hash, size and time stamp
+*   of every file written, so unchanged files are detected without reading them.
+*   File paths are relative to the output directory.
+*/
+class OutputWriter
+{
+public:
+    OutputWriter(const QString& outputDirectory, const QString& generatorName);
+    /// Waits for the pending files and saves the manifest.
+    ~OutputWriter();
+
+    /**
+    *   Queues contents to be written to filePath, unless the file already has them.
+    *   Blocks while too many files are waiting to be written.
+    */
+    void write(const QString& filePath, const QByteArray& contents);
+
+    /// Waits until all the queued files were handled.
+    void waitForDone();
+
+    /// Returns the number of files whose contents changed, waiting for the pending ones.
+    int numWritten();
+
+private:
+    class WriteTask;
+    struct ManifestEntry
+    {
+        QByteArray hash;
+        qint64 size;
+        uint lastModified;
+    };
+    typedef QHash<QString, ManifestEntry> ManifestHash;
+
+    void loadManifest();
+    bool saveManifest() const;
+    bool isUnchanged(const QString& filePath, const QByteArray& contents, const QByteArray& hash) const;
+    void writeFile(const QString& filePath, const QByteArray& contents);
+
+    QString m_outputDirectory;
+    QString m_manifestFileName;
+    // Accessed only from the writer thread.
+    ManifestHash m_manifest;
+    int m_numWritten;
+    QThreadPool m_pool;
+    QSemaphore m_freeSlots;
+};
+
+#endif // OUTPUTWRITER_H
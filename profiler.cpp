@@ -0,0 +1,249 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "profiler.h"
+#include <QtCore/QDateTime>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QTextStream>
+#include <QtCore/QThread>
+#include <time.h>
+#ifdef Q_OS_UNIX
+    #include <unistd.h>
+    #include <sys/resource.h>
+#endif
+#ifdef __GLIBC__
+    #include <malloc.h>
+    #if __GLIBC_PREREQ(2, 33)
+        #define HAVE_MALLINFO2 1
+    #endif
+#endif
+#ifndef HAVE_MALLINFO2
+    #define HAVE_MALLINFO2 0
+#endif
+
+namespace {
+
+struct Event
+{
+    const char* category;
+    QString name;
+    int thread;
+    qint64 start;
+    qint64 duration;
+    qint64 cpuTime;
+    qint64 heapDelta;
+};
+
+struct ProfilerData
+{
+    ProfilerData() : enabled(false), startTime(-1) {}
+
+    volatile bool enabled;
+    qint64 startTime;
+    QList<Event> events;
+    QHash<Qt::HANDLE, int> threads;
+    QMutex mutex;
+};
+
+}
+
+static ProfilerData* profilerData()
+{
+    static ProfilerData data;
+    return &data;
+}
+
+// Microseconds since some fixed point.
+static qint64 wallTime()
+{
+#if defined(_POSIX_MONOTONIC_CLOCK) && _POSIX_MONOTONIC_CLOCK >= 0
+    timespec ts;
+    if (!clock_gettime(CLOCK_MONOTONIC, &ts))
+        return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#endif
+    QDateTime now = QDateTime::currentDateTime();
+    return (qint64(now.toTime_t()) * 1000 + now.time().msec()) * 1000;
+}
+
+// Microseconds of CPU used by the current thread, 0 where it can't be known.
+static qint64 threadCpuTime()
+{
+#if defined(_POSIX_THREAD_CPUTIME) && _POSIX_THREAD_CPUTIME >= 0
+    timespec ts;
+    if (!clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+        return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#endif
+    return 0;
+}
+
+// Bytes allocated from the heap, 0 where it can't be known.
+// Older glibc versions only report the main arena, so what worker threads allocate
+// in arenas of their own is missing from the heap deltas of their events.
+static qint64 heapSize()
+{
+#if HAVE_MALLINFO2
+    // mallinfo() is deprecated, its int fields wrap past 2 GB.
+    struct mallinfo2 info = mallinfo2();
+    return qint64(info.uordblks) + qint64(info.hblkhd);
+#elif defined(__GLIBC__)
+    struct mallinfo info = mallinfo();
+    return qint64(uint(info.uordblks)) + qint64(uint(info.hblkhd));
+#else
+    return 0;
+#endif
+}
+
+// Writes str as a JSON string.
+static void writeJsonString(QTextStream& s, const QString& str)
+{
+    s << '"';
+    foreach (QChar c, str) {
+        if (c == '"' || c == '\\')
+            s << '\\' << c;
+        else if (c.unicode() < 0x20)
+            s << QString("\\u%1").arg(c.unicode(), 4, 16, QLatin1Char('0'));
+        else
+            s << c;
+    }
+    s << '"';
+}
+
+void Profiler::setEnabled(bool enable)
+{
+    ProfilerData* data = profilerData();
+    QMutexLocker locker(&data->mutex);
+    if (enable && data->startTime < 0)
+        data->startTime = wallTime();
+    data->enabled = enable;
+}
+
+bool Profiler::isEnabled()
+{
+    return profilerData()->enabled;
+}
+
+qint64 Profiler::residentMemory()
+{
+#ifdef Q_OS_LINUX
+    // The second field is the number of resident pages.
+    QFile statm("/proc/self/statm");
+    if (statm.open(QIODevice::ReadOnly)) {
+        QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.size() > 1)
+            return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+    }
+#endif
+    return 0;
+}
+
+qint64 Profiler::peakResidentMemory()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (!getrusage(RUSAGE_SELF, &usage)) {
+#ifdef Q_OS_MAC
+        return usage.ru_maxrss;
+#else
+        // Linux and the BSDs count kilobytes.
+        return qint64(usage.ru_maxrss) * 1024;
+#endif
+    }
+#endif
+    return 0;
+}
+
+Profiler::Sample Profiler::sample()
+{
+    Sample s;
+    s.wallTime = wallTime();
+    s.cpuTime = threadCpuTime();
+    s.heapSize = heapSize();
+    return s;
+}
+
+void Profiler::addEvent(const char* category, const QString& name, const Sample& begin, const Sample& end)
+{
+    ProfilerData* data = profilerData();
+    QMutexLocker locker(&data->mutex);
+
+    Qt::HANDLE threadId = QThread::currentThreadId();
+    QHash<Qt::HANDLE, int>::const_iterator it = data->threads.find(threadId);
+    if (it == data->threads.constEnd())
+        it = data->threads.insert(threadId, data->threads.count() + 1);
+
+    Event event;
+    event.category = category;
+    event.name = name;
+    event.thread = it.value();
+    event.start = begin.wallTime - data->startTime;
+    event.duration = end.wallTime - begin.wallTime;
+    event.cpuTime = end.cpuTime - begin.cpuTime;
+    event.heapDelta = end.heapSize - begin.heapSize;
+    data->events << event;
+}
+
+bool Profiler::save(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    ProfilerData* data = profilerData();
+    QMutexLocker locker(&data->mutex);
+    QTextStream s(&file);
+    s.setCodec("UTF-8");
+    s << "{\"traceEvents\":[";
+    bool first = true;
+    foreach (const Event& event, data->events) {
+        s << (first ? "\n" : ",\n");
+        first = false;
+        s << "{\"name\":";
+        writeJsonString(s, event.name);
+        s << ",\"cat\":";
+        writeJsonString(s, event.category);
+        s << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+          << ",\"ts\":" << event.start << ",\"dur\":" << event.duration
+          << ",\"args\":{\"cpu_us\":" << event.cpuTime << ",\"heap_delta\":" << event.heapDelta << "}}";
+    }
+    s << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    s.flush();
+    return file.error() == QFile::NoError;
+}
+
+ProfileScope::ProfileScope(const char* category, const QString& name)
+    : m_category(category), m_enabled(Profiler::isEnabled())
+{
+    if (m_enabled) {
+        m_name = name;
+        m_begin = Profiler::sample();
+    }
+}
+
+ProfileScope::~ProfileScope()
+{
+    if (m_enabled)
+        Profiler::addEvent(m_category, m_name, m_begin, Profiler::sample());
+}
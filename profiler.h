@@ -0,0 +1,84 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QtCore/QString>
+#include "generatorrunnermacros.h"
+
+/**
+*   Records how long the phases of a run, the generators and each generated class
+*   take, for the --profile option. The events are saved as a JSON file in the
+*   Trace Event format read by chrome://tracing. Events may be recorded from any
+*   thread; while the profiler is disabled, recording costs a single test.
+*/
+class GENRUNNER_API Profiler
+{
+public:
+    /// Starts or stops recording events, the time stamps start at the first call that enables it.
+    static void setEnabled(bool enable);
+    static bool isEnabled();
+
+    /// Writes all the recorded events to fileName, returns false if it couldn't be written.
+    static bool save(const QString& fileName);
+
+    /// Bytes of memory of the process currently resident, 0 where it can't be known.
+    static qint64 residentMemory();
+
+    /// Largest number of bytes of memory resident at any time so far, 0 where it can't be known.
+    static qint64 peakResidentMemory();
+
+private:
+    friend class ProfileScope;
+    struct Sample
+    {
+        qint64 wallTime;
+        qint64 cpuTime;
+        qint64 heapSize;
+    };
+    static Sample sample();
+    static void addEvent(const char* category, const QString& name, const Sample& begin, const Sample& end);
+};
+
+/**
+*   Records an event of the profiler lasting as long as the scope, with the wall
+*   time, the CPU time of the current thread and the change in the size of the heap.
+*   The heap is shared by all threads, so its change also counts the memory
+*   allocated by other threads running at the same time; with older glibc
+*   versions, the memory worker threads allocate isn't counted at all.
+*/
+class GENRUNNER_API ProfileScope
+{
+public:
+    ProfileScope(const char* category, const QString& name);
+    ~ProfileScope();
+
+private:
+    const char* m_category;
+    QString m_name;
+    bool m_enabled;
+    Profiler::Sample m_begin;
+};
+
+#endif // PROFILER_H
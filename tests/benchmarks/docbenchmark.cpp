@@ -0,0 +1,114 @@
+/*
+* This file is part of the Boost Python Generator project.
+*
+* Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+*
+* Contact: PySide team <contact@pyside.org>
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* version 2 as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+* 02110-1301 USA
+*
+*/
+
+#include "docbenchmark.h"
+#include <QtTest/QTest>
+
+// Number of times the sample qdoc3 section is repeated in the converted document.
+static const int SECTION_COUNT = 50;
+static const int TABLE_ROWS = 500;
+static const int TABLE_COLUMNS = 8;
+
+// A section with the tags found in most of the Qt class documentation.
+static const char SECTION[] =
+    "<para>The <link raw=\"QObject\" href=\"qobject.html\" type=\"class\">QObject</link> class is the "
+    "<bold>base class</bold> of all <italic>Qt objects</italic>. Call "
+    "<link raw=\"QObject::connect()\" href=\"qobject.html#connect\" type=\"function\">connect()</link> "
+    "with <argument>sender</argument> and <argument>receiver</argument>.</para>"
+    "<para><bold>Note:</bold> Objects are organized in object trees.</para>"
+    "<list type=\"bullet\">"
+    "<item><para>The first item, see <link raw=\"QWidget\" href=\"qwidget.html\" type=\"class\">QWidget</link>.</para></item>"
+    "<item><para>The second item.</para></item>"
+    "<item><para>The third item.</para></item>"
+    "</list>"
+    "<code>QObject *obj = new QPushButton;\n"
+    "obj-&gt;metaObject()-&gt;className();\n"
+    "QPushButton::staticMetaObject.className();</code>"
+    "<table><header><item><para>Constant</para></item><item><para>Description</para></item></header>"
+    "<row><item><para>Qt::AutoConnection</para></item><item><para>The default.</para></item></row>"
+    "<row><item><para>Qt::DirectConnection</para></item><item><para>Invoked immediately.</para></item></row>"
+    "</table>"
+    "<see-also><link raw=\"QMetaObject\" href=\"qmetaobject.html\" type=\"class\">QMetaObject</link></see-also>";
+
+void DocBenchmark::initTestCase()
+{
+    m_generator = new QtDocGenerator;
+
+    m_doc = "<description>";
+    for (int i = 0; i < SECTION_COUNT; ++i)
+        m_doc += SECTION;
+    m_doc += "</description>";
+
+    for (int i = 0; i < TABLE_ROWS; ++i) {
+        QtXmlToSphinx::TableRow row;
+        for (int j = 0; j < TABLE_COLUMNS; ++j) {
+            QtXmlToSphinx::TableCell cell(QString("Cell %1, %2\nsecond line").arg(i).arg(j));
+            if (!(i % 10) && j == 2)
+                cell.colSpan = 2;
+            if (!(i % 7) && j == 5)
+                cell.rowSpan = 3;
+            row << cell;
+        }
+        m_table << row;
+    }
+    m_table.enableHeader(true);
+}
+
+void DocBenchmark::cleanupTestCase()
+{
+    delete m_generator;
+}
+
+void DocBenchmark::benchmarkConvert()
+{
+    QtXmlToSphinx converter(m_generator);
+    QBENCHMARK {
+        converter.convert(m_doc, "PySide.QtCore.QObject");
+    }
+    QVERIFY(!converter.result().isEmpty());
+}
+
+void DocBenchmark::benchmarkTableNormalize()
+{
+    QBENCHMARK {
+        QtXmlToSphinx::Table table(m_table);
+        table.normalize();
+    }
+}
+
+void DocBenchmark::benchmarkTableRender()
+{
+    QtXmlToSphinx::Table table(m_table);
+    table.normalize();
+    QString output;
+    QBENCHMARK {
+        output.clear();
+        QTextStream s(&output);
+        s << table;
+    }
+    QVERIFY(!output.isEmpty());
+}
+
+QTEST_APPLESS_MAIN( DocBenchmark )
+
+#include "docbenchmark.moc"
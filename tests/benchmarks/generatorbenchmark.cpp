@@ -0,0 +1,193 @@
+/*
+* This file is part of the Boost Python Generator project.
+*
+* Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+*
+* Contact: PySide team <contact@pyside.org>
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* version 2 as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+* 02110-1301 USA
+*
+*/
+
+#include "generatorbenchmark.h"
+#include "dummygenerator.h"
+#include <apiextractor.h>
+#include <abstractmetalang.h>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QtTest/QTest>
+
+// Number of value and object types in the synthetic module.
+static const int CLASS_COUNT = 2000;
+
+// Writes a module in which each value type can only be built from the previous
+// one, and each object type has a few methods with value type arguments.
+static bool writeModule(const QString& headerFileName, const QString& typeSystemFileName)
+{
+    QFile header(headerFileName);
+    QFile typeSystem(typeSystemFileName);
+    if (!header.open(QIODevice::WriteOnly) || !typeSystem.open(QIODevice::WriteOnly))
+        return false;
+
+    QTextStream h(&header);
+    QTextStream t(&typeSystem);
+    t << "<typesystem package='benchmark'>" << endl;
+    t << "    <primitive-type name='int'/>" << endl;
+    t << "    <primitive-type name='double'/>" << endl;
+    t << "    <primitive-type name='bool'/>" << endl;
+
+    h << "struct Value0 { Value0(); int x; };" << endl;
+    t << "    <value-type name='Value0'/>" << endl;
+    for (int i = 1; i < CLASS_COUNT; ++i) {
+        h << QString("struct Value%1 { Value%1(const Value%2& v, int x); double y; };").arg(i).arg(i - 1) << endl;
+        t << QString("    <value-type name='Value%1'/>").arg(i) << endl;
+    }
+    for (int i = 0; i < CLASS_COUNT; ++i) {
+        QString base = i ? QString(" : public Object%1").arg(i - 1) : QString();
+        h << QString("class Object%1%2 {\npublic:\n"
+                     "    Object%1(Object%1* parent = 0);\n"
+                     "    virtual ~Object%1();\n"
+                     "    const Value%1& value() const;\n"
+                     "    void setValue(const Value%1& value, bool notify = true);\n"
+                     "    Object%1* findChild(int index, double* weight);\n"
+                     "};").arg(i).arg(base) << endl;
+        t << QString("    <object-type name='Object%1'/>").arg(i) << endl;
+    }
+    t << "</typesystem>" << endl;
+    return true;
+}
+
+static void removeDirectory(const QString& path)
+{
+    QDir dir(path);
+    foreach (const QFileInfo& info, dir.entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot)) {
+        if (info.isDir())
+            removeDirectory(info.filePath());
+        else
+            QFile::remove(info.filePath());
+    }
+    dir.rmdir(path);
+}
+
+void GeneratorBenchmark::initTestCase()
+{
+    // A directory of its own, so that runs at the same time don't share their files.
+    m_workDir = QString("%1/generatorbenchmark-%2").arg(QDir::tempPath()).arg(QCoreApplication::applicationPid());
+    removeDirectory(m_workDir);
+    QVERIFY(QDir().mkpath(m_workDir + "/output"));
+    QString headerFileName = m_workDir + "/benchmark.h";
+    QString typeSystemFileName = m_workDir + "/typesystem_benchmark.xml";
+    QVERIFY(writeModule(headerFileName, typeSystemFileName));
+
+    m_extractor = new ApiExtractor;
+    m_extractor->setSilent(true);
+    m_extractor->setCppFileName(headerFileName);
+    m_extractor->setTypeSystem(typeSystemFileName);
+    QVERIFY(m_extractor->run());
+    QVERIFY(m_extractor->classCount() >= 2 * CLASS_COUNT);
+
+    m_generator = new DummyGenerator;
+    m_generator->setOutputDirectory(m_workDir + "/output");
+    QVERIFY(m_generator->setup(*m_extractor, QMap<QString, QString>()));
+}
+
+void GeneratorBenchmark::cleanupTestCase()
+{
+    delete m_generator;
+    delete m_extractor;
+    removeDirectory(m_workDir);
+}
+
+void GeneratorBenchmark::benchmarkFormatCode()
+{
+    QString code;
+    for (int i = 0; i < 200; ++i) {
+        code += "        if (!PyArg_ParseTuple(args, \"|O:method\", &arg))\n"
+                "            return 0;\n"
+                "\n"
+                "        %0 = %CPPSELF.%FUNCTION_NAME(%1, %2);  \n";
+    }
+
+    QString output;
+    QBENCHMARK {
+        output.clear();
+        QTextStream s(&output);
+        Indentor indentor;
+        Indentation indentation(indentor);
+        formatCode(s, code, indentor);
+    }
+    QVERIFY(!output.isEmpty());
+}
+
+void GeneratorBenchmark::benchmarkTranslateType()
+{
+    int count = 0;
+    QBENCHMARK {
+        count = 0;
+        foreach (const AbstractMetaClass* metaClass, m_generator->classes()) {
+            foreach (const AbstractMetaFunction* func, metaClass->functions()) {
+                foreach (const AbstractMetaArgument* arg, func->arguments()) {
+                    m_generator->translateType(arg->type(), metaClass);
+                    m_generator->translateType(arg->type(), metaClass, Generator::ExcludeConst | Generator::ExcludeReference);
+                    ++count;
+                }
+            }
+        }
+    }
+    QVERIFY(count > 0);
+}
+
+void GeneratorBenchmark::benchmarkSetup()
+{
+    QBENCHMARK {
+        m_generator->setup(*m_extractor, QMap<QString, QString>());
+    }
+}
+
+void GeneratorBenchmark::benchmarkMinimalConstructor()
+{
+    // The minimal constructors found are kept until the next setup(), so only the
+    // first search over the classes is measured.
+    m_generator->setup(*m_extractor, QMap<QString, QString>());
+    QBENCHMARK_ONCE {
+        foreach (const AbstractMetaClass* metaClass, m_generator->classes())
+            m_generator->minimalConstructor(metaClass);
+    }
+}
+
+void GeneratorBenchmark::benchmarkGenerate_data()
+{
+    QTest::addColumn<int>("jobs");
+    QTest::newRow("1 job") << 1;
+    QTest::newRow("4 jobs") << 4;
+}
+
+void GeneratorBenchmark::benchmarkGenerate()
+{
+    QFETCH(int, jobs);
+    m_generator->setNumberOfJobs(jobs);
+    // The first iteration writes the files, the next ones find them unchanged like a rebuild does.
+    QBENCHMARK {
+        m_generator->generate();
+    }
+    QVERIFY(m_generator->numGenerated() > 0);
+}
+
+QTEST_MAIN( GeneratorBenchmark )
+
+#include "generatorbenchmark.moc"
@@ -0,0 +1,123 @@
+/*
+* This file is part of the Boost Python Generator project.
+*
+* Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+*
+* Contact: PySide team <contact@pyside.org>
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* version 2 as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+* 02110-1301 USA
+*
+*/
+
+#include "codesnippetindextest.h"
+#include "codesnippetindex.h"
+#include <QtTest/QTest>
+#include <QFileInfo>
+#include <QStringList>
+
+static const char SNIPPET_FILE[] = "\
+int main()\n\
+{\n\
+//! [0]\n\
+    int a = 0;\n\
+//! [1]\n\
+    int b = 1; //! [2]\n\
+//! [1]\n\
+    return a;\n\
+//! [0]\n\
+}\n\
+//! [3]\n\
+// end of file";
+
+void CodeSnippetIndexTest::init()
+{
+    m_file = new QTemporaryFile;
+    QVERIFY(m_file->open());
+    m_file->write(SNIPPET_FILE);
+    m_file->close();
+}
+
+void CodeSnippetIndexTest::cleanup()
+{
+    delete m_file;
+}
+
+void CodeSnippetIndexTest::testWholeFile()
+{
+    CodeSnippetIndex index;
+    QString code;
+    QCOMPARE(index.snippet(m_file->fileName(), QString(), &code), CodeSnippetIndex::SnippetFound);
+    QCOMPARE(code, QString(SNIPPET_FILE));
+}
+
+void CodeSnippetIndexTest::testSnippet()
+{
+    CodeSnippetIndex index;
+    QString code;
+    QCOMPARE(index.snippet(m_file->fileName(), "1", &code), CodeSnippetIndex::SnippetFound);
+    QCOMPARE(code, QString("    int b = 1; \n"));
+    // Served from the index the second time.
+    QCOMPARE(index.snippet(m_file->fileName(), "1", &code), CodeSnippetIndex::SnippetFound);
+    QCOMPARE(code, QString("    int b = 1; \n"));
+}
+
+void CodeSnippetIndexTest::testNestedSnippets()
+{
+    CodeSnippetIndex index;
+    QString code;
+    QCOMPARE(index.snippet(m_file->fileName(), "0", &code), CodeSnippetIndex::SnippetFound);
+    QCOMPARE(code, QString("    int a = 0;\n\n    int b = 1; \n\n    return a;\n"));
+}
+
+void CodeSnippetIndexTest::testUnterminatedSnippet()
+{
+    CodeSnippetIndex index;
+    QString code;
+    QCOMPARE(index.snippet(m_file->fileName(), "3", &code), CodeSnippetIndex::SnippetFound);
+    QCOMPARE(code, QString("// end of file"));
+}
+
+void CodeSnippetIndexTest::testMissingSnippet()
+{
+    CodeSnippetIndex index;
+    QString code;
+    QCOMPARE(index.snippet(m_file->fileName(), "4", &code), CodeSnippetIndex::SnippetNotFound);
+}
+
+void CodeSnippetIndexTest::testMissingFile()
+{
+    CodeSnippetIndex index;
+    QString code;
+    QCOMPARE(index.snippet(m_file->fileName() + ".missing", "0", &code), CodeSnippetIndex::FileNotFound);
+}
+
+void CodeSnippetIndexTest::testFindFile()
+{
+    QFileInfo info(m_file->fileName());
+    CodeSnippetIndex index;
+    index.setSearchDirectories(QStringList() << info.absolutePath() + "/missing" << info.absolutePath());
+    QCOMPARE(index.findFile(info.fileName()), info.absolutePath() + '/' + info.fileName());
+    QCOMPARE(index.findFile(info.fileName() + ".missing"), QString());
+    QCOMPARE(index.avoidedProbes(), 2);
+
+    // Both lookups are remembered.
+    index.findFile(info.fileName());
+    index.findFile(info.fileName() + ".missing");
+    QCOMPARE(index.avoidedProbes(), 6);
+}
+
+QTEST_APPLESS_MAIN( CodeSnippetIndexTest )
+
+#include "codesnippetindextest.moc"
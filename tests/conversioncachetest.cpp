@@ -0,0 +1,104 @@
+/*
+* This file is part of the Boost Python Generator project.
+*
+* Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+*
+* Contact: PySide team <contact@pyside.org>
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* version 2 as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+* 02110-1301 USA
+*
+*/
+
+#include "conversioncachetest.h"
+#include "conversioncache.h"
+#include <QtTest/QTest>
+#include <QTemporaryFile>
+
+void ConversionCacheTest::testKey()
+{
+    QByteArray key = ConversionCache::key("<para>doc</para>", "QObject", 0);
+    QCOMPARE(ConversionCache::key("<para>doc</para>", "QObject", 0), key);
+    QVERIFY(ConversionCache::key("<para>doc</para>", "QWidget", 0) != key);
+    QVERIFY(ConversionCache::key("<para>doc</para>", "QObject", 4) != key);
+    QVERIFY(ConversionCache::key("<para>other</para>", "QObject", 0) != key);
+}
+
+void ConversionCacheTest::testReuse()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    QByteArray key = ConversionCache::key("<para>doc</para>", "QObject", 0);
+    QString result;
+
+    ConversionCache first;
+    first.load(file.fileName(), "salt");
+    QVERIFY(!first.find(key, &result));
+    first.insert(key, "doc\n");
+    QVERIFY(first.save());
+
+    ConversionCache second;
+    second.load(file.fileName(), "salt");
+    QVERIFY(second.find(key, &result));
+    QCOMPARE(result, QString("doc\n"));
+    QCOMPARE(second.hits(), 1);
+    QCOMPARE(second.misses(), 0);
+}
+
+void ConversionCacheTest::testDifferentSalt()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    QByteArray key = ConversionCache::key("<para>doc</para>", "QObject", 0);
+    QString result;
+
+    ConversionCache first;
+    first.load(file.fileName(), "salt");
+    first.insert(key, "doc\n");
+    QVERIFY(first.save());
+
+    ConversionCache second;
+    second.load(file.fileName(), "other salt");
+    QVERIFY(!second.find(key, &result));
+    QCOMPARE(second.misses(), 1);
+}
+
+void ConversionCacheTest::testOnlyUsedConversionsAreSaved()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    QByteArray used = ConversionCache::key("<para>used</para>", "QObject", 0);
+    QByteArray unused = ConversionCache::key("<para>unused</para>", "QObject", 0);
+    QString result;
+
+    ConversionCache first;
+    first.load(file.fileName(), "salt");
+    first.insert(used, "used\n");
+    first.insert(unused, "unused\n");
+    QVERIFY(first.save());
+
+    ConversionCache second;
+    second.load(file.fileName(), "salt");
+    QVERIFY(second.find(used, &result));
+    QVERIFY(second.save());
+
+    ConversionCache third;
+    third.load(file.fileName(), "salt");
+    QVERIFY(third.find(used, &result));
+    QVERIFY(!third.find(unused, &result));
+}
+
+QTEST_APPLESS_MAIN( ConversionCacheTest )
+
+#include "conversioncachetest.moc"
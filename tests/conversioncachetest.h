@@ -0,0 +1,39 @@
+/*
+* This file is part of the Boost Python Generator project.
+*
+* Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+*
+* Contact: PySide team <contact@pyside.org>
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* version 2 as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+* 02110-1301 USA
+*
+*/
+
+#ifndef CONVERSIONCACHETEST_H
+#define CONVERSIONCACHETEST_H
+
+#include <QObject>
+
+class ConversionCacheTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void testKey();
+    void testReuse();
+    void testDifferentSalt();
+    void testOnlyUsedConversionsAreSaved();
+};
+
+#endif
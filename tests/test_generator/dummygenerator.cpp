@@ -31,18 +31,70 @@ using namespace std;
 QString
 DummyGenerator::fileNameForClass(const AbstractMetaClass* metaClass) const
 {
+#ifdef DUMMY_COPY_GENERATOR
+    return QString("%1_copy.txt").arg(metaClass->name().toLower());
+#else
     return QString("%1_generated.txt").arg(metaClass->name().toLower());
+#endif
 }
 
 void
 DummyGenerator::generateClass(QTextStream& s, const AbstractMetaClass* metaClass)
 {
+    logGeneration("generate " + metaClass->name());
     s << "// Generated code for class: " << qPrintable(metaClass->name()) << endl;
 }
 
+void
+DummyGenerator::finishGeneration()
+{
+    logGeneration("finish");
+}
+
+void
+DummyGenerator::beginBatch(const AbstractMetaClassList& classes)
+{
+    logBatch("begin", classes);
+}
+
+void
+DummyGenerator::endBatch(const AbstractMetaClassList& classes)
+{
+    logBatch("end", classes);
+}
+
+void
+DummyGenerator::logBatch(const char* event, const AbstractMetaClassList& classes)
+{
+    if (m_batchLogFileName.isEmpty())
+        return;
+    QFile logFile(m_batchLogFileName);
+    logFile.open(QIODevice::Append | QIODevice::Text);
+    QTextStream out(&logFile);
+    out << event;
+    foreach (const AbstractMetaClass* metaClass, classes)
+        out << ' ' << metaClass->name();
+    out << endl;
+}
+
+void
+DummyGenerator::logGeneration(const QString& line)
+{
+    if (m_generationLogFileName.isEmpty())
+        return;
+    // Classes may be generated by several threads at once.
+    QMutexLocker locker(&m_generationLogMutex);
+    QFile logFile(m_generationLogFileName);
+    logFile.open(QIODevice::Append | QIODevice::Text);
+    QTextStream out(&logFile);
+    out << line << endl;
+}
+
 bool
 DummyGenerator::doSetup(const QMap<QString, QString>& args)
 {
+    m_batchLogFileName = args.value("dump-batches");
+    m_generationLogFileName = args.value("dump-generation");
     if (args.contains("dump-arguments") && !args["dump-arguments"].isEmpty()) {
         QFile logFile(args["dump-arguments"]);
         logFile.open(QIODevice::WriteOnly | QIODevice::Text);
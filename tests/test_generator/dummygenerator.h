@@ -23,6 +23,7 @@
 #ifndef DUMMYGENERATOR_H
 #define DUMMYGENERATOR_H
 
+#include <QMutex>
 #include "generator.h"
 
 class GENRUNNER_API DummyGenerator : public Generator
@@ -31,14 +32,32 @@ public:
     DummyGenerator() {}
     ~DummyGenerator() {}
     bool doSetup(const QMap<QString, QString>& args);
+#ifdef DUMMY_COPY_GENERATOR
+    const char* name() const { return "DummyCopyGenerator"; }
+#else
     const char* name() const { return "DummyGenerator"; }
+#endif
+    Capabilities capabilities() const
+    {
+        return Capabilities(ThreadSafeClassGeneration) | ReadOnlyModelAccess | IncrementalGeneration
+               | GenerationHooks;
+    }
 
 protected:
     void writeFunctionArguments(QTextStream&, const AbstractMetaFunction*, Options) const {}
     void writeArgumentNames(QTextStream&, const AbstractMetaFunction*, Options) const {}
     QString fileNameForClass(const AbstractMetaClass* metaClass) const;
     void generateClass(QTextStream& s, const AbstractMetaClass* metaClass);
-    void finishGeneration() {}
+    void finishGeneration();
+    void beginBatch(const AbstractMetaClassList& classes);
+    void endBatch(const AbstractMetaClassList& classes);
+
+private:
+    void logBatch(const char* event, const AbstractMetaClassList& classes);
+    void logGeneration(const QString& line);
+    QString m_batchLogFileName;
+    QString m_generationLogFileName;
+    QMutex m_generationLogMutex;
 };
 
 #endif // DUMMYGENERATOR_H
@@ -24,12 +24,90 @@
 #include "dummygentest.h"
 #include "dummygenerator.h"
 #include "dummygentestconfig.h"
+#include <QDateTime>
+#include <QDir>
+#include <QSet>
+#include <QFileInfo>
 #include <QTemporaryFile>
+#include <QTextStream>
 #include <QtTest/QTest>
 #include <QProcess>
 
 #define GENERATED_CONTENTS  "// Generated code for class: Dummy"
 
+/// Returns the lines of a log written by DummyGenerator, and removes it for the next run.
+static QStringList takeLog(const QString& path)
+{
+    QStringList lines;
+    QFile logFile(path);
+    if (logFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        while (!logFile.atEnd())
+            lines << QString::fromUtf8(logFile.readLine()).trimmed();
+        logFile.close();
+        logFile.remove();
+    }
+    return lines;
+}
+
+/// Same as takeLog(), with the class names of each batch sorted.
+static QStringList takeBatchLog(const QString& path)
+{
+    QStringList lines = takeLog(path);
+    for (int i = 0; i < lines.size(); ++i) {
+        QStringList words = lines[i].split(' ');
+        QString event = words.takeFirst();
+        words.sort();
+        lines[i] = QString("%1 %2").arg(event).arg(words.join(" "));
+    }
+    return lines;
+}
+
+/// Returns the classes logged as generated by takeLog(path).
+static QSet<QString> takeGeneratedClasses(const QString& path)
+{
+    QSet<QString> classes;
+    foreach (const QString& line, takeLog(path)) {
+        if (line.startsWith("generate "))
+            classes << line.section(' ', 1);
+    }
+    return classes;
+}
+
+/// Writes a project file generating headerFile and typesystemFile with the dummy generator.
+static void writeProjectFile(const QString& path, const QString& headerFile, const QString& typesystemFile,
+                             const QString& outputDir)
+{
+    QFile projectFile(path);
+    projectFile.open(QIODevice::WriteOnly | QIODevice::Text);
+    QTextStream out(&projectFile);
+    out << "[generator-project]" << endl << endl;
+    out << "generator-set = dummy" << endl;
+    out << "header-file = " << headerFile << endl;
+    out << "typesystem-file = " << typesystemFile << endl;
+    out << "output-directory = " << outputDir << endl;
+}
+
+static void writeBatchFile(const QString& path, const QStringList& lines)
+{
+    QFile batchFile(path);
+    batchFile.open(QIODevice::WriteOnly | QIODevice::Text);
+    QTextStream out(&batchFile);
+    foreach (const QString& line, lines)
+        out << line << endl;
+}
+
+static void removeDirectory(const QString& path)
+{
+    QDir dir(path);
+    foreach (const QFileInfo& info, dir.entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot)) {
+        if (info.isDir())
+            removeDirectory(info.filePath());
+        else
+            QFile::remove(info.filePath());
+    }
+    dir.rmdir(path);
+}
+
 void DummyGenTest::initTestCase()
 {
     int argc = 0;
@@ -40,6 +118,9 @@ void DummyGenTest::initTestCase()
     headerFilePath = workDir + "/test_global.h";
     typesystemFilePath = workDir + "/test_typesystem.xml";
     projectFilePath = workDir + "/dummygentest-project.txt";
+    nestedHeaderFilePath = workDir + "/test_nested.h";
+    nestedTypesystemFilePath = workDir + "/test_nested_typesystem.xml";
+    nestedOutputDir = QDir::tempPath() + "/dummygen-nested";
     generatedFilePath = QString("%1/dummy/dummy_generated.txt").arg(QDir::tempPath());
 }
 
@@ -96,6 +177,234 @@ void DummyGenTest::testCallDummyGeneratorExecutable()
     QVERIFY(generatedFile.remove());
 }
 
+void DummyGenTest::testCallGenRunnerWithJobs()
+{
+    QStringList args;
+    args.append("--generator-set=dummy");
+    args.append("--jobs=4");
+    args.append(QString("--output-directory=%1").arg(QDir::tempPath()));
+    args.append(headerFilePath);
+    args.append(typesystemFilePath);
+    int result = QProcess::execute("generatorrunner", args);
+    QCOMPARE(result, 0);
+
+    QFile generatedFile(generatedFilePath);
+    generatedFile.open(QIODevice::ReadOnly);
+    QCOMPARE(generatedFile.readAll().trimmed(), QByteArray(GENERATED_CONTENTS).trimmed());
+    generatedFile.close();
+
+    QVERIFY(generatedFile.remove());
+}
+
+void DummyGenTest::testParallelGenerators()
+{
+    QString generationLogPath = workDir + "/dummygen-generation.log";
+    QFile::remove(generationLogPath);
+
+    // Both generators only read the model, so they run at the same time.
+    QStringList args;
+    args.append("--generator-set=dummy,dummy_copy");
+    args.append("--parallel-generators");
+    args.append(QString("--dump-generation=%1").arg(generationLogPath));
+    args.append(QString("--output-directory=%1").arg(QDir::tempPath()));
+    args.append(headerFilePath);
+    args.append(typesystemFilePath);
+    QCOMPARE(QProcess::execute("generatorrunner", args), 0);
+
+    QStringList log = takeLog(generationLogPath);
+    log.sort();
+    QCOMPARE(log, QStringList() << "finish" << "finish" << "generate Dummy" << "generate Dummy");
+
+    QString copyFilePath = QString("%1/dummy/dummy_copy.txt").arg(QDir::tempPath());
+    foreach (const QString& filePath, QStringList() << generatedFilePath << copyFilePath) {
+        QFile generatedFile(filePath);
+        QVERIFY(generatedFile.open(QIODevice::ReadOnly));
+        QCOMPARE(generatedFile.readAll().trimmed(), QByteArray(GENERATED_CONTENTS).trimmed());
+        generatedFile.close();
+        QVERIFY(generatedFile.remove());
+    }
+}
+
+void DummyGenTest::testIncrementalGeneration()
+{
+    QString generationLogPath = workDir + "/dummygen-generation.log";
+    QFile::remove(generationLogPath);
+
+    QStringList args;
+    args.append("--generator-set=dummy");
+    args.append("--incremental");
+    args.append(QString("--dump-generation=%1").arg(generationLogPath));
+    args.append(QString("--output-directory=%1").arg(QDir::tempPath()));
+    args.append(headerFilePath);
+    args.append(typesystemFilePath);
+    QCOMPARE(QProcess::execute("generatorrunner", args), 0);
+    QCOMPARE(takeLog(generationLogPath), QStringList() << "generate Dummy" << "finish");
+
+    QFile cacheFile(QDir::tempPath() + "/.DummyGenerator.cache");
+    QVERIFY(cacheFile.exists());
+
+    // The second run finds the class up to date, it must keep its output without generating it.
+    QCOMPARE(QProcess::execute("generatorrunner", args), 0);
+    QCOMPARE(takeLog(generationLogPath), QStringList() << "finish");
+
+    // Options of the runner that don't change the output keep the cache valid.
+    QCOMPARE(QProcess::execute("generatorrunner", QStringList(args) << "--jobs=4" << "--memory-limit=512"), 0);
+    QCOMPARE(takeLog(generationLogPath), QStringList() << "finish");
+
+    QFile generatedFile(generatedFilePath);
+    generatedFile.open(QIODevice::ReadOnly);
+    QCOMPARE(generatedFile.readAll().trimmed(), QByteArray(GENERATED_CONTENTS).trimmed());
+    generatedFile.close();
+
+    // Without the output file the class is generated again.
+    QVERIFY(generatedFile.remove());
+    QCOMPARE(QProcess::execute("generatorrunner", args), 0);
+    QCOMPARE(takeLog(generationLogPath), QStringList() << "generate Dummy" << "finish");
+
+    QVERIFY(generatedFile.remove());
+    QVERIFY(cacheFile.remove());
+}
+
+void DummyGenTest::testUnchangedOutputIsNotRewritten()
+{
+    QStringList args;
+    args.append("--generator-set=dummy");
+    args.append(QString("--output-directory=%1").arg(QDir::tempPath()));
+    args.append(headerFilePath);
+    args.append(typesystemFilePath);
+    QCOMPARE(QProcess::execute("generatorrunner", args), 0);
+
+    QFile manifestFile(QDir::tempPath() + "/.DummyGenerator.manifest");
+    QVERIFY(manifestFile.exists());
+
+    // A rewritten file would get a later time stamp, the second run must leave it alone.
+    QFileInfo info(generatedFilePath);
+    QDateTime lastModified = info.lastModified();
+    QTest::qSleep(1100);
+    QCOMPARE(QProcess::execute("generatorrunner", args), 0);
+    info.refresh();
+    QCOMPARE(info.lastModified(), lastModified);
+
+    QFile generatedFile(generatedFilePath);
+    generatedFile.open(QIODevice::ReadOnly);
+    QCOMPARE(generatedFile.readAll().trimmed(), QByteArray(GENERATED_CONTENTS).trimmed());
+    generatedFile.close();
+
+    QVERIFY(generatedFile.remove());
+    QVERIFY(manifestFile.remove());
+}
+
+void DummyGenTest::testShardedGeneration()
+{
+    QString generationLogPath = workDir + "/dummygen-generation.log";
+    QFile::remove(generationLogPath);
+
+    QStringList args;
+    args.append("--generator-set=dummy");
+    args.append(QString("--dump-generation=%1").arg(generationLogPath));
+    args.append(QString("--output-directory=%1").arg(QDir::tempPath()));
+    args.append(headerFilePath);
+    args.append(typesystemFilePath);
+
+    // The only class goes to one of the shards, and the merge needs both.
+    // The shards keep other state files beside their records, the merge must ignore them.
+    QCOMPARE(QProcess::execute("generatorrunner", QStringList(args) << "--shard=1/2"), 0);
+    QCOMPARE(QProcess::execute("generatorrunner", QStringList(args) << "--shard=2/2"), 0);
+    QFile firstShard(QDir::tempPath() + "/.DummyGenerator.shard-1-of-2");
+    QFile secondShard(QDir::tempPath() + "/.DummyGenerator.shard-2-of-2");
+    QVERIFY(firstShard.exists());
+    QVERIFY(secondShard.exists());
+    QVERIFY(QFile::exists(QDir::tempPath() + "/.DummyGenerator.shard-1-of-2.manifest"));
+    QCOMPARE(takeLog(generationLogPath), QStringList() << "generate Dummy");
+
+    QCOMPARE(QProcess::execute("generatorrunner", QStringList(args) << "--merge-shards"), 0);
+    QCOMPARE(takeLog(generationLogPath), QStringList() << "finish");
+
+    QFile generatedFile(generatedFilePath);
+    generatedFile.open(QIODevice::ReadOnly);
+    QCOMPARE(generatedFile.readAll().trimmed(), QByteArray(GENERATED_CONTENTS).trimmed());
+    generatedFile.close();
+
+    QCOMPARE(QProcess::execute("generatorrunner", QStringList(args) << "--shard=3/2"), 1);
+
+    // A merge missing a shard fails without finishing the generation, a copy of the
+    // record under another name doesn't stand in for it.
+    QVERIFY(secondShard.copy(QDir::tempPath() + "/.DummyGenerator.shard-2-of-2.saved"));
+    QVERIFY(secondShard.remove());
+    QCOMPARE(QProcess::execute("generatorrunner", QStringList(args) << "--merge-shards"), 1);
+    QVERIFY(takeLog(generationLogPath).isEmpty());
+
+    // So does a merge of two records of the same shard.
+    QVERIFY(firstShard.copy(secondShard.fileName()));
+    QCOMPARE(QProcess::execute("generatorrunner", QStringList(args) << "--merge-shards"), 1);
+    QVERIFY(takeLog(generationLogPath).isEmpty());
+
+    QVERIFY(generatedFile.remove());
+    QVERIFY(firstShard.remove());
+    QVERIFY(secondShard.remove());
+    QVERIFY(QFile::remove(QDir::tempPath() + "/.DummyGenerator.shard-2-of-2.saved"));
+    QFile::remove(QDir::tempPath() + "/.DummyGenerator.shard-1-of-2.manifest");
+    QFile::remove(QDir::tempPath() + "/.DummyGenerator.shard-2-of-2.manifest");
+}
+
+void DummyGenTest::testGenerationHooks()
+{
+    QString batchLogPath = workDir + "/dummygen-batches.log";
+    QString generationLogPath = workDir + "/dummygen-generation.log";
+    QFile::remove(batchLogPath);
+    QFile::remove(generationLogPath);
+
+    QStringList args;
+    args.append("--generator-set=dummy");
+    args.append(QString("--dump-batches=%1").arg(batchLogPath));
+    args.append(QString("--output-directory=%1").arg(QDir::tempPath()));
+    args.append(headerFilePath);
+    args.append(typesystemFilePath);
+    QCOMPARE(QProcess::execute("generatorrunner", args), 0);
+    QCOMPARE(takeBatchLog(batchLogPath), QStringList() << "begin Dummy" << "end Dummy");
+    QVERIFY(QFile::remove(generatedFilePath));
+
+    // A namespace and the classes nested in it make up a single batch.
+    removeDirectory(nestedOutputDir);
+    QStringList nestedArgs;
+    nestedArgs.append("--generator-set=dummy");
+    nestedArgs.append(QString("--dump-batches=%1").arg(batchLogPath));
+    nestedArgs.append(QString("--output-directory=%1").arg(nestedOutputDir));
+    nestedArgs.append(nestedHeaderFilePath);
+    nestedArgs.append(nestedTypesystemFilePath);
+    QStringList incrementalArgs = QStringList(nestedArgs) << "--incremental";
+    QCOMPARE(QProcess::execute("generatorrunner", incrementalArgs), 0);
+    QStringList outerBatch = QStringList() << "begin First Inner Outer Second" << "end First Inner Outer Second";
+    QStringList standaloneBatch = QStringList() << "begin Standalone" << "end Standalone";
+    QStringList batches = takeBatchLog(batchLogPath);
+    if (batches.value(0) == standaloneBatch.first())
+        QCOMPARE(batches, standaloneBatch + outerBatch);
+    else
+        QCOMPARE(batches, outerBatch + standaloneBatch);
+
+    // Classes left up to date by incremental generation are not part of the batches.
+    QVERIFY(QFile::remove(nestedOutputDir + "/nested/inner_generated.txt"));
+    QCOMPARE(QProcess::execute("generatorrunner", incrementalArgs), 0);
+    QCOMPARE(takeBatchLog(batchLogPath), QStringList() << "begin Inner" << "end Inner");
+
+    // The classes of a batch are generated by the same shard.
+    QSet<QString> outerClasses = QSet<QString>() << "Outer" << "First" << "Inner" << "Second";
+    QSet<QString> generated;
+    nestedArgs.append(QString("--dump-generation=%1").arg(generationLogPath));
+    for (int shard = 1; shard <= 2; ++shard) {
+        QString shardArg = QString("--shard=%1/2").arg(shard);
+        QCOMPARE(QProcess::execute("generatorrunner", QStringList(nestedArgs) << shardArg), 0);
+        QSet<QString> shardClasses = takeGeneratedClasses(generationLogPath);
+        int outerInShard = QSet<QString>(shardClasses).intersect(outerClasses).size();
+        QVERIFY(outerInShard == 0 || outerInShard == outerClasses.size());
+        generated += shardClasses;
+    }
+    QCOMPARE(generated, QSet<QString>(outerClasses) << "Standalone");
+
+    QFile::remove(batchLogPath);
+    removeDirectory(nestedOutputDir);
+}
+
 void DummyGenTest::testProjectFileArgumentsReading()
 {
     QStringList args(QString("--project-file=%1/dummygentest-project.txt").arg(workDir));
@@ -127,6 +436,95 @@ void DummyGenTest::testProjectFileArgumentsReading()
              QDir::toNativeSeparators(QString("typesystem-paths = /typesystem/path/location1%1/typesystem/path/location2").arg(PATH_SPLITTER)));
 }
 
+void DummyGenTest::testBatchFile()
+{
+    QTemporaryFile batchFile;
+    QVERIFY(batchFile.open());
+    batchFile.write("# Comments and empty lines are skipped\n\n");
+    batchFile.write(QFile::encodeName(projectFilePath) + "\n");
+    batchFile.close();
+
+    // Options from the command line override those of the project files.
+    QStringList args;
+    args.append(QString("--batch-file=%1").arg(batchFile.fileName()));
+    args.append("--api-version=4.5");
+    QCOMPARE(QProcess::execute("generatorrunner", args), 0);
+
+    QFile logFile(workDir + "/dummygen-args.log");
+    logFile.open(QIODevice::ReadOnly);
+    QStringList logContents;
+    while (!logFile.atEnd())
+        logContents << logFile.readLine().trimmed();
+    logContents.sort();
+    QCOMPARE(logContents[0], QString("api-version = 4.5"));
+    QCOMPARE(logContents[3], QString("generator-set = dummy"));
+
+    // A dependency must be one of the projects of the batch.
+    QVERIFY(batchFile.open());
+    batchFile.resize(0);
+    batchFile.write(QFile::encodeName(projectFilePath) + ": missing-project.txt\n");
+    batchFile.close();
+    QCOMPARE(QProcess::execute("generatorrunner", args), 1);
+}
+
+void DummyGenTest::testBatchDependencies()
+{
+    QString batchDir = QDir::tempPath() + "/dummygen-batch";
+    removeDirectory(batchDir);
+    QVERIFY(QDir().mkpath(batchDir));
+    QString batchFilePath = batchDir + "/batch.txt";
+    QString generationLogPath = batchDir + "/generation.log";
+    writeProjectFile(batchDir + "/dummy.txt", headerFilePath, typesystemFilePath, batchDir + "/dummy-output");
+    writeProjectFile(batchDir + "/docindex.txt", workDir + "/test_docindex.h",
+                     workDir + "/test_docindex_typesystem.xml", batchDir + "/docindex-output");
+    writeProjectFile(batchDir + "/nested.txt", nestedHeaderFilePath, nestedTypesystemFilePath,
+                     batchDir + "/nested-output");
+    writeProjectFile(batchDir + "/broken.txt", headerFilePath, batchDir + "/missing_typesystem.xml",
+                     batchDir + "/broken-output");
+
+    QStringList args;
+    args.append(QString("--batch-file=%1").arg(batchFilePath));
+    args.append(QString("--dump-generation=%1").arg(generationLogPath));
+
+    // A project runs after the projects it depends on, even when listed before them.
+    writeBatchFile(batchFilePath, QStringList() << "docindex.txt: dummy.txt" << "dummy.txt");
+    QCOMPARE(QProcess::execute("generatorrunner", args), 0);
+    QStringList log = takeLog(generationLogPath);
+    QCOMPARE(log.count("finish"), 2);
+    QVERIFY(log.contains("generate QFirst"));
+    QVERIFY(log.indexOf("generate Dummy") < log.indexOf("finish"));
+    QVERIFY(log.indexOf("finish") < log.indexOf("generate QFirst"));
+
+    // The projects depending on a failed one are skipped, the others still run.
+    writeBatchFile(batchFilePath, QStringList() << "broken.txt" << "docindex.txt: broken.txt" << "dummy.txt");
+    QCOMPARE(QProcess::execute("generatorrunner", args), 1);
+    QCOMPARE(takeLog(generationLogPath), QStringList() << "generate Dummy" << "finish");
+
+    // Independent projects run side by side, each one with its own type database.
+    writeBatchFile(batchFilePath, QStringList() << "dummy.txt" << "docindex.txt" << "nested.txt");
+    QCOMPARE(QProcess::execute("generatorrunner", QStringList(args) << "--batch-jobs=3"), 0);
+    log = takeLog(generationLogPath);
+    QCOMPARE(log.count("finish"), 3);
+    QCOMPARE(log.size(), 3 + 1 + 2 + 5);
+    QVERIFY(log.contains("generate Dummy"));
+    QVERIFY(log.contains("generate QSecond"));
+    QVERIFY(log.contains("generate Standalone"));
+
+    QCOMPARE(QProcess::execute("generatorrunner", QStringList(args) << "--batch-jobs=0"), 1);
+
+#ifndef Q_OS_WIN
+    // Only a colon followed by white space starts the dependencies, not one inside a path.
+    writeProjectFile(batchDir + "/dummy:copy.txt", headerFilePath, typesystemFilePath, batchDir + "/copy-output");
+    writeBatchFile(batchFilePath, QStringList() << "dummy:copy.txt" << "docindex.txt:\tdummy:copy.txt");
+    QCOMPARE(QProcess::execute("generatorrunner", args), 0);
+    log = takeLog(generationLogPath);
+    QCOMPARE(log.count("finish"), 2);
+    QVERIFY(log.indexOf("generate Dummy") < log.indexOf("generate QFirst"));
+#endif
+
+    removeDirectory(batchDir);
+}
+
 QTEST_APPLESS_MAIN(DummyGenTest)
 
 #include "dummygentest.moc"
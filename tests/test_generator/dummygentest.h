@@ -38,13 +38,24 @@ private:
     QString typesystemFilePath;
     QString generatedFilePath;
     QString projectFilePath;
+    QString nestedHeaderFilePath;
+    QString nestedTypesystemFilePath;
+    QString nestedOutputDir;
 
 private slots:
     void initTestCase();
     void testCallGenRunnerWithFullPathToDummyGenModule();
     void testCallGenRunnerWithNameOfDummyGenModule();
     void testCallDummyGeneratorExecutable();
+    void testCallGenRunnerWithJobs();
+    void testParallelGenerators();
+    void testIncrementalGeneration();
+    void testUnchangedOutputIsNotRewritten();
+    void testShardedGeneration();
+    void testGenerationHooks();
     void testProjectFileArgumentsReading();
+    void testBatchFile();
+    void testBatchDependencies();
 };
 
 #endif
@@ -0,0 +1,94 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "qtdocgentest.h"
+#include "dummygentestconfig.h"
+#include <QDir>
+#include <QFile>
+#include <QtTest/QTest>
+#include <QProcess>
+
+// The start of the package index written by the documentation generator, before
+// the module documentation: the TOC table is indented as the content of its container.
+#define PACKAGE_INDEX_CONTENTS \
+".. module:: docindex\n" \
+"\n" \
+"docindex\n" \
+"********\n" \
+"\n" \
+".. container:: pysidetoc\n" \
+"\n" \
+"    +---------------+----------------+\n" \
+"    |**F**          |**S**           |\n" \
+"    |               |                |\n" \
+"    |* :doc:`QFirst`|* :doc:`QSecond`|\n" \
+"    |               |                |\n" \
+"    +---------------+----------------+\n" \
+"\n" \
+"    .. container:: hide\n" \
+"\n" \
+"        .. toctree::\n" \
+"            :maxdepth: 1\n" \
+"\n" \
+"            QFirst.rst\n" \
+"            QSecond.rst\n" \
+"\n" \
+"\n" \
+"Detailed Description\n" \
+"--------------------\n" \
+"\n"
+
+void QtDocGenTest::testPackageIndex()
+{
+    QString workDir = QDir::currentPath();
+    QString outputDir = QDir::tempPath() + "/qtdocgen-index";
+
+    // There is no documentation to extract, only the index is checked.
+    QStringList args;
+    args.append("--generator-set=" QTDOCGENERATOR_BINARY_DIR "/qtdoc_generator" MODULE_EXTENSION);
+    args.append(QString("--output-directory=%1").arg(outputDir));
+    args.append(QString("--library-source-dir=%1").arg(workDir));
+    args.append(QString("--documentation-data-dir=%1").arg(workDir));
+    args.append(workDir + "/test_docindex.h");
+    args.append(workDir + "/test_docindex_typesystem.xml");
+    QCOMPARE(QProcess::execute("generatorrunner", args), 0);
+
+    QFile indexFile(outputDir + "/docindex/index.rst");
+    QVERIFY(indexFile.open(QIODevice::ReadOnly));
+    QByteArray expected(PACKAGE_INDEX_CONTENTS);
+    QCOMPARE(indexFile.read(expected.size()), expected);
+    indexFile.close();
+
+    QDir docDir(outputDir + "/docindex");
+    foreach (const QString& fileName, docDir.entryList(QDir::Files | QDir::Hidden))
+        docDir.remove(fileName);
+    QDir(outputDir).rmdir("docindex");
+    QDir dir(outputDir);
+    foreach (const QString& fileName, dir.entryList(QDir::Files | QDir::Hidden))
+        dir.remove(fileName);
+    QDir::temp().rmdir("qtdocgen-index");
+}
+
+QTEST_APPLESS_MAIN(QtDocGenTest)
+
+#include "qtdocgentest.moc"
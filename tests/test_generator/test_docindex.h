@@ -0,0 +1,2 @@
+struct QFirst {};
+struct QSecond {};
@@ -0,0 +1,10 @@
+namespace Outer
+{
+    struct First
+    {
+        struct Inner {};
+    };
+    struct Second {};
+}
+
+struct Standalone {};